@@ -1,27 +1,31 @@
 #include "devices/input.h"
 #include <debug.h>
-#include "devices/intq.h"
 #include "devices/serial.h"
+#include "devices/spscq.h"
+#include "threads/interrupt.h"
 
-/* Stores keys from the keyboard and serial port. */
-static struct intq buffer;
+/* Stores keys from the keyboard and serial port.  The keyboard
+   and serial interrupt handlers produce, one at a time since
+   external interrupts do not nest, and input_getc() consumes. */
+static struct spscq buffer;
 
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
-  intq_init (&buffer);
+  spscq_init (&buffer);
 }
 
 /* Adds a key to the input buffer.
-   Interrupts must be off and the buffer must not be full. */
+   Must be called from an external interrupt handler, and the
+   buffer must not be full. */
 void
 input_putc (uint8_t key) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT (!intq_full (&buffer));
+  ASSERT (intr_context ());
+  ASSERT (!input_full ());
 
-  intq_putc (&buffer, key);
+  spscq_putc (&buffer, key);
   serial_notify ();
 }
 
@@ -30,23 +34,15 @@ input_putc (uint8_t key)
 uint8_t
 input_getc (void) 
 {
-  enum intr_level old_level;
-  uint8_t key;
-
-  old_level = intr_disable ();
-  key = intq_getc (&buffer);
+  uint8_t key = spscq_getc (&buffer);
   serial_notify ();
-  intr_set_level (old_level);
-  
   return key;
 }
 
 /* Returns true if the input buffer is full,
-   false otherwise.
-   Interrupts must be off. */
+   false otherwise. */
 bool
 input_full (void) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  return intq_full (&buffer);
+  return spscq_full (&buffer);
 }
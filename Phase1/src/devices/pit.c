@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,58 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts the given CHANNEL counting down COUNT cycles once, in
+   mode 0 ("interrupt on terminal count").  The channel's output
+   drops to 0 immediately and rises to 1 when the count expires,
+   and stays there until the channel is reprogrammed, so channel
+   0 raises exactly one interrupt.  A COUNT of 0 is treated as
+   65536.
+
+   Interrupts must be off. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (0 << 1));
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+}
+
+/* Returns the current value of CHANNEL's down-counter, which
+   must have been programmed for both counter bytes, as both
+   pit_configure_channel() and pit_start_oneshot() do.
+
+   Interrupts must be off. */
+uint16_t
+pit_read_counter (int channel)
+{
+  uint8_t lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Counter latch command, then read the latched value. */
+  outb (PIT_PORT_CONTROL, channel << 6);
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  return lo | (hi << 8);
+}
+
+/* Returns the state of CHANNEL's output pin, using the 8254
+   read-back command.
+
+   Interrupts must be off. */
+bool
+pit_read_output (int channel)
+{
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Read-back command: latch status only, for CHANNEL.  Bit 7
+     of the status byte is the output pin. */
+  outb (PIT_PORT_CONTROL, 0xe0 | (2 << channel));
+  return (inb (PIT_PORT_COUNTER (channel)) & 0x80) != 0;
+}
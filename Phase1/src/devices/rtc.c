@@ -1,4 +1,5 @@
 #include "devices/rtc.h"
+#include <debug.h>
 #include <round.h>
 #include <stdio.h>
 #include "threads/io.h"
@@ -29,14 +30,22 @@
 
 /* Register A. */
 #define RTCSA_UIP	0x80	/* Set while time update in progress. */
+#define RTCSA_RATE	0x0f	/* Periodic rate: 32768 >> (rate - 1) Hz. */
+#define RTCSA_1024HZ	0x06	/* Rate for 1024 Hz. */
 
 /* Register B. */
 #define	RTCSB_SET	0x80	/* Disables update to let time be set. */
 #define RTCSB_DM	0x04	/* 0 = BCD time format, 1 = binary format. */
 #define RTCSB_24HR	0x02    /* 0 = 12-hour format, 1 = 24-hour format. */
+#define RTCSB_PIE	0x40	/* Periodic interrupt enable. */
 
 static int bcd_to_bin (uint8_t);
 static uint8_t cmos_read (uint8_t index);
+static void cmos_write (uint8_t index, uint8_t data);
+static void rtc_interrupt (struct intr_frame *);
+
+/* Called on each periodic interrupt. */
+static intr_handler_func *periodic_handler;
 
 /* Returns number of seconds since Unix epoch of January 1,
    1970. */
@@ -96,6 +105,39 @@ rtc_get_time (void)
   return time;
 }
 
+/* Starts the RTC raising an interrupt RTC_PERIODIC_HZ times per
+   second and calls HANDLER from each one.  Unlike the timer, the
+   RTC ticks independently of the scheduler, which makes it a
+   good clock for sampling what the CPU is doing. */
+void
+rtc_start_periodic (intr_handler_func *handler) 
+{
+  enum intr_level old_level;
+
+  ASSERT (RTC_PERIODIC_HZ == 32768 >> (RTCSA_1024HZ - 1));
+
+  old_level = intr_disable ();
+  periodic_handler = handler;
+  intr_register_ext (0x28, rtc_interrupt, "MC146818A RTC");
+  cmos_write (RTC_REG_A,
+              (cmos_read (RTC_REG_A) & ~RTCSA_RATE) | RTCSA_1024HZ);
+  cmos_write (RTC_REG_B, cmos_read (RTC_REG_B) | RTCSB_PIE);
+
+  /* Clear any interrupt already pending, or the RTC will never
+     raise another one. */
+  cmos_read (RTC_REG_C);
+  intr_set_level (old_level);
+}
+
+/* RTC interrupt handler. */
+static void
+rtc_interrupt (struct intr_frame *f) 
+{
+  /* Reading register C acknowledges the interrupt. */
+  cmos_read (RTC_REG_C);
+  periodic_handler (f);
+}
+
 /* Returns the integer value of the given BCD byte. */
 static int
 bcd_to_bin (uint8_t x)
@@ -111,3 +153,11 @@ cmos_read (uint8_t index)
   outb (CMOS_REG_SET, index);
   return inb (CMOS_REG_IO);
 }
+
+/* Writes DATA to the CMOS register with the given INDEX. */
+static void
+cmos_write (uint8_t index, uint8_t data)
+{
+  outb (CMOS_REG_SET, index);
+  outb (CMOS_REG_IO, data);
+}
@@ -1,8 +1,15 @@
 #ifndef RTC_H
 #define RTC_H
 
+#include "threads/interrupt.h"
+
 typedef unsigned long time_t;
 
 time_t rtc_get_time (void);
 
+/* Frequency of the RTC periodic interrupt. */
+#define RTC_PERIODIC_HZ 1024
+
+void rtc_start_periodic (intr_handler_func *);
+
 #endif
@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
+#include "devices/spscq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -51,8 +51,15 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted.  Threads produce, serialized by the
+   console lock, and the serial interrupt handler consumes.
+   TX_PRODUCING is true while a thread is adding a byte, so that
+   code that interrupts it knows not to add bytes of its own. */
+static struct spscq txq;
+static volatile bool tx_producing;
+
+/* Last value written to the interrupt enable register. */
+static volatile uint8_t ier;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
@@ -71,7 +78,7 @@ init_poll (void)
   outb (FCR_REG, 0);                    /* Disable FIFO. */
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  spscq_init (&txq);
   mode = POLL;
 } 
 
@@ -98,35 +105,55 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
-  enum intr_level old_level = intr_disable ();
+  enum intr_level old_level;
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
          use dumb polling to transmit a byte. */
+      old_level = intr_disable ();
       if (mode == UNINIT)
         init_poll ();
       putc_poll (byte); 
+      intr_set_level (old_level);
     }
-  else 
+  else if (intr_get_level () == INTR_OFF)
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      /* With interrupts off the serial interrupt handler cannot
+         run, so we may stand in for it as the consumer.  If the
+         transmit queue is full, we cannot wait for it to empty
+         without reenabling interrupts, which is impolite, and if
+         we interrupted a thread in the middle of adding a byte,
+         adding ours could clobber it.  In either case, send
+         everything queued so far and then our byte by polling. */
+      if (tx_producing || spscq_full (&txq))
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          serial_flush ();
+          putc_poll (byte);
+        }
+      else
+        {
+          spscq_putc (&txq, byte);
+          write_ier ();
+        }
+    }
+  else
+    {
+      /* Otherwise, queue a byte without turning interrupts off,
+         and only if the transmit interrupt is off, because the
+         queue was empty, turn it on. */
+      tx_producing = true;
+      barrier ();
+      spscq_putc (&txq, byte);
+      barrier ();
+      tx_producing = false;
+      if ((ier & IER_XMIT) == 0)
+        {
+          old_level = intr_disable ();
+          write_ier ();
+          intr_set_level (old_level);
         }
-
-      intq_putc (&txq, byte); 
-      write_ier ();
     }
-  
-  intr_set_level (old_level);
 }
 
 /* Flushes anything in the serial buffer out the port in polling
@@ -135,21 +162,30 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  uint8_t buf[SPSCQ_BUFSIZE];
+  size_t cnt, i;
+
+  while ((cnt = spscq_get (&txq, buf, sizeof buf)) > 0)
+    for (i = 0; i < cnt; i++)
+      putc_poll (buf[i]);
   intr_set_level (old_level);
 }
 
 /* The fullness of the input buffer may have changed.  Reassess
    whether we should block receive interrupts.
    Called by the input buffer routines when characters are added
-   to or removed from the buffer. */
+   to or removed from the buffer.  Removing a character can only
+   matter if receive interrupts are blocked, so in the common
+   case this does not turn interrupts off. */
 void
 serial_notify (void) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  if (mode == QUEUE)
-    write_ier ();
+  if (mode == QUEUE && (intr_context () || (ier & IER_RECV) == 0))
+    {
+      enum intr_level old_level = intr_disable ();
+      write_ier ();
+      intr_set_level (old_level);
+    }
 }
 
 /* Configures the serial port for BPS bits per second. */
@@ -176,21 +212,22 @@ set_serial (int bps)
 static void
 write_ier (void) 
 {
-  uint8_t ier = 0;
+  uint8_t new_ier = 0;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
-    ier |= IER_XMIT;
+  if (!spscq_empty (&txq))
+    new_ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
      characters we receive. */
   if (!input_full ())
-    ier |= IER_RECV;
+    new_ier |= IER_RECV;
   
-  outb (IER_REG, ier);
+  ier = new_ier;
+  outb (IER_REG, new_ier);
 }
 
 /* Polls the serial port until it's ready,
@@ -209,6 +246,8 @@ putc_poll (uint8_t byte)
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
 {
+  uint8_t byte;
+
   /* Inquire about interrupt in UART.  Without this, we can
      occasionally miss an interrupt running under QEMU. */
   inb (IIR_REG);
@@ -218,10 +257,12 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* As long as the hardware is ready to accept a byte for
+     transmission, and we have a byte to transmit, transmit a
+     byte. */
+  while ((inb (LSR_REG) & LSR_THRE) != 0
+         && spscq_get (&txq, &byte, 1) == 1)
+    outb (THR_REG, byte);
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -4,8 +4,13 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -95,6 +100,8 @@ shutdown_power_off (void)
 #endif
 
   print_stats ();
+  if (trace_enabled)
+    trace_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -130,6 +137,10 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
+  slab_print_stats ();
+  intr_print_stats ();
+  profile_print ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
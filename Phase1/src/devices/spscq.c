@@ -0,0 +1,176 @@
+#include "devices/spscq.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* The producer stores a byte into BUF before it advances HEAD,
+   and the consumer loads a byte from BUF before it advances
+   TAIL.  x86 does not reorder stores with other stores or loads
+   with other loads, so compiler barriers are enough to keep
+   either side from seeing a slot before it is ready. */
+
+static unsigned load_index (const unsigned *);
+static void wake (struct thread **waiter);
+
+/* Initializes Q as empty. */
+void
+spscq_init (struct spscq *q)
+{
+  q->not_full = q->not_empty = NULL;
+  q->head = q->tail = 0;
+}
+
+/* Returns the number of bytes in Q.  From either side, this is
+   a lower bound: the other side may add or remove bytes at any
+   time. */
+size_t
+spscq_count (const struct spscq *q)
+{
+  return load_index (&q->head) - load_index (&q->tail);
+}
+
+/* Returns the number of bytes that can be added to Q. */
+size_t
+spscq_space (const struct spscq *q)
+{
+  return SPSCQ_BUFSIZE - spscq_count (q);
+}
+
+/* Returns true if Q is empty, false otherwise. */
+bool
+spscq_empty (const struct spscq *q)
+{
+  return spscq_count (q) == 0;
+}
+
+/* Returns true if Q is full, false otherwise. */
+bool
+spscq_full (const struct spscq *q)
+{
+  return spscq_count (q) == SPSCQ_BUFSIZE;
+}
+
+/* Adds up to CNT bytes from BUF to the end of Q, as many as
+   there is room for, and returns the number added.  Must only
+   be called by Q's producer. */
+size_t
+spscq_put (struct spscq *q, const void *buf_, size_t cnt)
+{
+  const uint8_t *buf = buf_;
+  unsigned head = q->head;
+  size_t i;
+
+  if (cnt > spscq_space (q))
+    cnt = spscq_space (q);
+  for (i = 0; i < cnt; i++)
+    q->buf[(head + i) % SPSCQ_BUFSIZE] = buf[i];
+  barrier ();
+  q->head = head + cnt;
+  barrier ();
+
+  if (cnt > 0)
+    wake (&q->not_empty);
+  return cnt;
+}
+
+/* Removes up to CNT bytes from the front of Q into BUF, as many
+   as Q holds, and returns the number removed.  Must only be
+   called by Q's consumer. */
+size_t
+spscq_get (struct spscq *q, void *buf_, size_t cnt)
+{
+  uint8_t *buf = buf_;
+  unsigned tail = q->tail;
+  size_t i;
+
+  if (cnt > spscq_count (q))
+    cnt = spscq_count (q);
+  for (i = 0; i < cnt; i++)
+    buf[i] = q->buf[(tail + i) % SPSCQ_BUFSIZE];
+  barrier ();
+  q->tail = tail + cnt;
+  barrier ();
+
+  if (cnt > 0)
+    wake (&q->not_full);
+  return cnt;
+}
+
+/* Adds BYTE to the end of Q.  If Q is full, sleeps until the
+   consumer removes a byte.  Must only be called by Q's producer.
+   When called from an interrupt handler, or with interrupts off,
+   Q must not be full. */
+void
+spscq_putc (struct spscq *q, uint8_t byte)
+{
+  while (spscq_put (q, &byte, 1) == 0)
+    {
+      enum intr_level old_level;
+
+      ASSERT (!intr_context ());
+      ASSERT (intr_get_level () == INTR_ON);
+      old_level = intr_disable ();
+      if (spscq_full (q))
+        {
+          q->not_full = thread_current ();
+          thread_block ();
+        }
+      intr_set_level (old_level);
+    }
+}
+
+/* Removes a byte from Q and returns it.  If Q is empty, sleeps
+   until the producer adds a byte.  Must only be called by Q's
+   consumer.  When called from an interrupt handler, or with
+   interrupts off, Q must not be empty. */
+uint8_t
+spscq_getc (struct spscq *q)
+{
+  uint8_t byte;
+
+  while (spscq_get (q, &byte, 1) == 0)
+    {
+      enum intr_level old_level;
+
+      ASSERT (!intr_context ());
+      ASSERT (intr_get_level () == INTR_ON);
+      old_level = intr_disable ();
+      if (spscq_empty (q))
+        {
+          q->not_empty = thread_current ();
+          thread_block ();
+        }
+      intr_set_level (old_level);
+    }
+  return byte;
+}
+
+/* Returns the value of the index at P, which the other side may
+   be changing. */
+static unsigned
+load_index (const unsigned *p)
+{
+  return *(const volatile unsigned *) p;
+}
+
+/* If a thread is waiting in *WAITER, wakes it up and resets
+   *WAITER.  The unlocked check keeps the common case, in which
+   nobody is waiting, from having to turn interrupts off.  A
+   waiter sets *WAITER with interrupts off after it has seen the
+   queue empty or full, so if we miss it here, it is because it
+   had not yet looked, and it will see what we just did. */
+static void
+wake (struct thread **waiter)
+{
+  if (*(struct thread *volatile *) waiter != NULL)
+    {
+      enum intr_level old_level = intr_disable ();
+      if (*waiter != NULL)
+        {
+          thread_unblock (*waiter);
+          *waiter = NULL;
+        }
+      intr_set_level (old_level);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef DEVICES_SPSCQ_H
+#define DEVICES_SPSCQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A lock-free single-producer, single-consumer queue of bytes,
+   for handing data between an external interrupt handler and a
+   kernel thread.
+
+   Unlike an intq, which needs interrupts off around every byte,
+   the producer and consumer can move bytes in and out of an
+   spscq without turning interrupts off, because each side writes
+   only its own index and reads the other's.  A side that must
+   wait, for data or for room, turns interrupts off only while it
+   goes to sleep, so that it cannot miss its wakeup.
+
+   There may be only one producer and one consumer at a time.  It
+   is up to the caller to make sure of that, for example by only
+   producing from one interrupt handler.  Either side may be an
+   interrupt handler or a kernel thread, but only a kernel thread
+   can wait. */
+
+/* Queue buffer size, in bytes.  Must be a power of 2. */
+#define SPSCQ_BUFSIZE 64
+
+/* A circular queue of bytes. */
+struct spscq
+  {
+    /* Waiting threads. */
+    struct thread *not_full;    /* Producer waiting for room. */
+    struct thread *not_empty;   /* Consumer waiting for data. */
+
+    /* Queue.  HEAD and TAIL count the bytes ever added and
+       removed, so the queue holds HEAD - TAIL bytes. */
+    uint8_t buf[SPSCQ_BUFSIZE]; /* Buffer. */
+    unsigned head;              /* Written only by the producer. */
+    unsigned tail;              /* Written only by the consumer. */
+  };
+
+void spscq_init (struct spscq *);
+size_t spscq_count (const struct spscq *);
+size_t spscq_space (const struct spscq *);
+bool spscq_empty (const struct spscq *);
+bool spscq_full (const struct spscq *);
+
+/* Batch operations, which never wait. */
+size_t spscq_put (struct spscq *, const void *, size_t);
+size_t spscq_get (struct spscq *, void *, size_t);
+
+/* Single bytes, waiting if necessary. */
+void spscq_putc (struct spscq *, uint8_t);
+uint8_t spscq_getc (struct spscq *);
+
+#endif /* devices/spscq.h */
@@ -1,32 +1,93 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <heap.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
-#if TIMER_FREQ < 19
-#error 8254 timer requires TIMER_FREQ >= 19
-#endif
-#if TIMER_FREQ > 1000
-#error TIMER_FREQ <= 1000 recommended
-#endif
+/* Number of timer interrupts per second.  Set by kernel
+   command-line option "-hz" before timer_init() runs. */
+int timer_freq = TIMER_FREQ_DEFAULT;
 
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* Time-stamp counter cycles per second, or 0 until
+   timer_calibrate() has measured it against the PIT.  We assume
+   an invariant TSC, one that ticks at a constant rate whatever
+   the CPU's power state, as every CPU of the last decade has. */
+static uint64_t tsc_hz;
+
+/* PIT cycles to measure the TSC against in timer_calibrate(). */
+#define CALIBRATE_CYCLES (PIT_HZ / 50)
+
+/* If true, stop the periodic timer interrupt while the CPU is
+   idle and program a one-shot interrupt for the next sleeping
+   thread's wake tick instead.  Controlled by kernel command-line
+   option "-tickless". */
+bool timer_tickless;
+
+/* PIT cycles in one timer tick, and the most ticks that fit in
+   the PIT's 16-bit counter. */
+#define TICK_CYCLES ((unsigned) (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define ONESHOT_MAX_TICKS (65535 / TICK_CYCLES)
+
+/* While the timer is in one-shot mode, the number of tick
+   boundaries the one-shot spans and the PIT count it was started
+   with.  ONESHOT_TICKS is 0 while the timer is periodic. */
+static int oneshot_ticks;
+static unsigned oneshot_cycles;
+
+/* High-resolution timers.
+
+   A thread that sleeps for a time that is not a whole number of
+   ticks waits on a struct hrtimer in HRTIMERS, which is ordered
+   by TSC deadline.  The periodic tick checks the earliest
+   deadline.  If it falls before the next tick, the PIT switches
+   to one-shot mode (HR_ONESHOT) and is programmed for whichever
+   comes first, the earliest deadline or the next tick boundary,
+   HR_TICK_TSC.  Tick boundaries are counted off in TSC cycles
+   while in this mode, so the tick keeps its phase, and once a
+   tick boundary is reached with no deadline before the next one,
+   the PIT goes back to periodic mode. */
+struct hrtimer
+  {
+    uint64_t deadline;          /* TSC value at which to wake. */
+    struct thread *thread;      /* Thread to wake. */
+    struct heap_elem elem;      /* Element in HRTIMERS. */
+  };
+static struct heap hrtimers;
+static bool hr_oneshot;         /* PIT in one-shot mode for hrtimers? */
+static uint64_t hr_tick_tsc;    /* When the next tick is due. */
+static uint64_t hr_event_tsc;   /* When the one-shot is due. */
+
+/* Fewest PIT cycles to program a one-shot for, so that the
+   interrupt does not arrive before we are ready for it. */
+#define HR_MIN_CYCLES 20
+
+/* Cost of the timer interrupt handler, in time-stamp counter
+   cycles.  Read by timer_get_intr_stats(). */
+static int64_t intr_cnt;
+static uint64_t intr_cycles;
+static uint64_t intr_max_cycles;
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops(unsigned loops);
-static void busy_wait(int64_t loops);
+static void timer_tick (void);
+static void timer_restart_periodic (void);
+static heap_less_func hrtimer_less;
+static void hrtimer_sleep (uint64_t deadline);
+static void hrtimer_arm (void);
+static void hrtimer_expire (uint64_t now);
+static void hrtimer_interrupt (void);
+static void hrtimer_program (uint64_t deadline);
+static uint64_t to_tsc (int64_t num, int32_t denom);
 static void real_time_sleep(int64_t num, int32_t denom);
 static void real_time_delay(int64_t num, int32_t denom);
 
@@ -36,32 +97,56 @@ void timer_init(void)
 {
   pit_configure_channel(0, 2, TIMER_FREQ);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
+  heap_init(&hrtimers, hrtimer_less, NULL);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Measures the time-stamp counter frequency against the PIT,
+   which counts down at a known rate, for timer_ns(), brief
+   delays and high-resolution sleeps.  Takes CALIBRATE_CYCLES
+   PIT cycles, or 20 ms. */
 void timer_calibrate(void)
 {
-  unsigned high_bit, test_bit;
+  enum intr_level old_level;
+  unsigned elapsed = 0;
+  unsigned prev, cur;
+  uint64_t start;
 
   ASSERT(intr_get_level() == INTR_ON);
   printf("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops(loops_per_tick << 1))
+  /* The PIT counts down from TICK_CYCLES to 1 once per tick.
+     Sample it often enough never to miss a whole period; an
+     interrupt handler takes far less than that. */
+  old_level = intr_disable();
+  prev = pit_read_counter(0);
+  start = rdtsc();
+  intr_set_level(old_level);
+  while (elapsed < CALIBRATE_CYCLES)
   {
-    loops_per_tick <<= 1;
-    ASSERT(loops_per_tick != 0);
+    old_level = intr_disable();
+    cur = pit_read_counter(0);
+    intr_set_level(old_level);
+
+    elapsed += cur <= prev ? prev - cur : prev + TICK_CYCLES - cur;
+    prev = cur;
   }
+  tsc_hz = (rdtsc() - start) * PIT_HZ / elapsed;
+
+  printf("%'" PRIu64 " TSC cycles/s.\n", tsc_hz);
+}
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops(loops_per_tick | test_bit))
-      loops_per_tick |= test_bit;
+/* Returns the number of nanoseconds since the CPU was reset,
+   or, until timer_calibrate() has run, since the OS booted,
+   with only tick resolution. */
+int64_t
+timer_ns(void)
+{
+  uint64_t tsc = rdtsc();
 
-  printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+  if (tsc_hz == 0)
+    return timer_ticks() * (1000 * 1000 * 1000 / TIMER_FREQ);
+  return tsc / tsc_hz * 1000 * 1000 * 1000
+         + tsc % tsc_hz * 1000 * 1000 * 1000 / tsc_hz;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -93,12 +178,15 @@ void timer_sleep(int64_t ticks)
     return;
   }
   intr_disable();
-  sleep_thread(ticks);
+  sleep_thread(start + ticks);
   intr_set_level(INTR_ON);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
-   turned on. */
+   turned on.  This and the other sub-tick sleeps block on a
+   high-resolution timer, so they wake up on time to within the
+   PIT's resolution of about a microsecond, plus the time it takes
+   to schedule the thread. */
 void timer_msleep(int64_t ms)
 {
   real_time_sleep(ms, 1000);
@@ -158,92 +246,339 @@ void timer_print_stats(void)
 }
 
 
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  In tickless mode, replaces the periodic
+   timer interrupt by a single interrupt at the next sleeping
+   thread's wake tick, or as far out as the PIT can count. */
+void
+timer_idle_enter (void)
+{
+  int64_t idle_ticks;
+  unsigned cycles_left;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks != 0
+      || hr_oneshot || !heap_empty (&hrtimers))
+    return;
+
+  idle_ticks = thread_next_wake_tick () - ticks;
+  if (idle_ticks > ONESHOT_MAX_TICKS)
+    idle_ticks = ONESHOT_MAX_TICKS;
+  if (idle_ticks < 2)
+    return;
+
+  /* Keep the tick phase: the one-shot runs out the rest of the
+     current period and then IDLE_TICKS - 1 whole periods. */
+  cycles_left = pit_read_counter (0);
+  if (cycles_left == 0 || cycles_left > TICK_CYCLES)
+    cycles_left = TICK_CYCLES;
+
+  oneshot_ticks = idle_ticks;
+  oneshot_cycles = cycles_left + (idle_ticks - 1) * TICK_CYCLES;
+  pit_start_oneshot (0, oneshot_cycles);
+}
+
+/* Called by the idle thread, with interrupts off, after the CPU
+   was woken by an interrupt.  If that was not the one-shot timer
+   interrupt, goes back to the periodic timer and accounts for
+   the tick boundaries that passed while the CPU was halted. */
+void
+timer_idle_exit (void)
+{
+  unsigned elapsed, first;
+  int passed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  elapsed = oneshot_cycles - pit_read_counter (0);
+  first = oneshot_cycles - (oneshot_ticks - 1) * TICK_CYCLES;
+  passed = elapsed < first ? 0 : 1 + (elapsed - first) / TICK_CYCLES;
+  if (passed >= oneshot_ticks)
+    passed = oneshot_ticks - 1;
+
+  timer_restart_periodic ();
+  while (passed-- > 0)
+    timer_tick ();
+}
+
+/* Clears the timer interrupt handler cost statistics. */
+void
+timer_reset_intr_stats (void)
+{
+  enum intr_level old_level = intr_disable ();
+  intr_cnt = 0;
+  intr_cycles = 0;
+  intr_max_cycles = 0;
+  intr_set_level (old_level);
+}
+
+/* Stores the average and the maximum number of time-stamp
+   counter cycles spent in the timer interrupt handler since the
+   last timer_reset_intr_stats() into *AVG_CYCLES and
+   *MAX_CYCLES. */
+void
+timer_get_intr_stats (uint64_t *avg_cycles, uint64_t *max_cycles)
+{
+  enum intr_level old_level = intr_disable ();
+  *avg_cycles = intr_cnt > 0 ? intr_cycles / intr_cnt : 0;
+  *max_cycles = intr_max_cycles;
+  intr_set_level (old_level);
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
+{
+  uint64_t start = rdtsc ();
+  uint64_t cycles;
+  int passed = 1;
+
+  /* An interrupt that arrives in one-shot mode before the PIT
+     output goes high was raised by the periodic timer just
+     before the switch, so it is an ordinary tick. */
+  if (hr_oneshot && pit_read_output (0))
+    hrtimer_interrupt ();
+  else
+    {
+      if (oneshot_ticks != 0 && pit_read_output (0))
+        {
+          passed = oneshot_ticks;
+          timer_restart_periodic ();
+        }
+      while (passed-- > 0)
+        timer_tick ();
+      if (!heap_empty (&hrtimers))
+        {
+          hrtimer_expire (rdtsc ());
+          hrtimer_arm ();
+        }
+    }
+
+  cycles = rdtsc () - start;
+  intr_cnt++;
+  intr_cycles += cycles;
+  if (cycles > intr_max_cycles)
+    intr_max_cycles = cycles;
+}
+
+/* Returns the timer to its periodic mode after a tickless idle
+   period. */
+static void
+timer_restart_periodic (void)
+{
+  oneshot_ticks = 0;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+}
+
+/* Advances the clock by one tick and does the per-tick
+   scheduler bookkeeping. */
+static void
+timer_tick (void)
 {
   ticks++; 
   thread_tick ();
   if (thread_mlfqs){
     recent_inc();
-    if (ticks % 4 == 3){
-      // all_priority_calc();
-      thread_foreach(priority_clac,NULL);
+    /* Between the once-a-second updates only the running thread's
+       recent_cpu changes, so it is the only priority to redo, once
+       per time slice.  A thread that leaves the CPU in the middle
+       of a slice has its priority redone by schedule().  The run
+       queue is only touched for threads whose priority moved. */
+    if (ticks % thread_time_slice == thread_time_slice - 1){
+      priority_clac(thread_current(),NULL);
     }
     if (ticks % TIMER_FREQ == 0){
       load_avg_calc();
       thread_foreach(recent_clac,NULL);
-      // priority_clac(thread_current());
     }
   }
 
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
+/* Orders hrtimers by deadline. */
 static bool
-too_many_loops(unsigned loops)
+hrtimer_less (const struct heap_elem *a_, const struct heap_elem *b_,
+              void *aux UNUSED)
 {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier();
+  const struct hrtimer *a = heap_entry (a_, struct hrtimer, elem);
+  const struct hrtimer *b = heap_entry (b_, struct hrtimer, elem);
+
+  return a->deadline < b->deadline;
+}
+
+/* Blocks the running thread until the time-stamp counter reaches
+   DEADLINE.  Interrupts must be on. */
+static void
+hrtimer_sleep (uint64_t deadline)
+{
+  struct hrtimer timer;
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait(loops);
+  ASSERT (intr_get_level () == INTR_ON);
 
-  /* If the tick count changed, we iterated too long. */
-  barrier();
-  return start != ticks;
+  timer.deadline = deadline;
+  timer.thread = thread_current ();
+
+  /* Even a deadline that passes before we block is safe: the
+     interrupt that wakes us cannot arrive until we block. */
+  intr_disable ();
+  heap_insert (&hrtimers, &timer.elem);
+  hrtimer_arm ();
+  thread_block ();
+  intr_enable ();
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait(int64_t loops)
+/* Makes sure that the PIT interrupts in time for the earliest
+   hrtimer, switching it to one-shot mode if the earliest
+   deadline comes before the next tick.  Interrupts must be
+   off. */
+static void
+hrtimer_arm (void)
 {
-  while (loops-- > 0)
-    barrier();
+  uint64_t deadline;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (oneshot_ticks == 0);
+
+  if (heap_empty (&hrtimers))
+    return;
+  deadline = heap_entry (heap_min (&hrtimers), struct hrtimer, elem)->deadline;
+
+  if (!hr_oneshot)
+    {
+      /* In periodic mode the PIT counter tells how far away the
+         next tick is. */
+      uint64_t next_tick = (rdtsc ()
+                            + pit_read_counter (0) * tsc_hz / PIT_HZ);
+      if (deadline >= next_tick)
+        return;
+      hr_oneshot = true;
+      hr_tick_tsc = next_tick;
+      hrtimer_program (deadline);
+    }
+  else if (deadline < hr_event_tsc && !pit_read_output (0))
+    {
+      /* Move the one-shot earlier, unless it has already fired,
+         in which case the pending interrupt will take care of
+         DEADLINE. */
+      hrtimer_program (deadline);
+    }
+}
+
+/* Wakes the threads whose hrtimers expired by time NOW. */
+static void
+hrtimer_expire (uint64_t now)
+{
+  while (!heap_empty (&hrtimers))
+    {
+      struct hrtimer *timer = heap_entry (heap_min (&hrtimers),
+                                          struct hrtimer, elem);
+      if (timer->deadline > now)
+        break;
+
+      heap_pop_min (&hrtimers);
+      thread_unblock (timer->thread);
+      if (thread_runs_before (timer->thread, thread_current ()))
+        intr_yield_on_return ();
+    }
+}
+
+/* Handles the expiry of the one-shot PIT interrupt in
+   HR_ONESHOT mode: runs the ticks that are due, wakes the
+   threads whose hrtimers are due, and programs the next
+   interrupt. */
+static void
+hrtimer_interrupt (void)
+{
+  uint64_t tick_tsc = tsc_hz / TIMER_FREQ;
+  uint64_t now = rdtsc ();
+  bool ticked = false;
+
+  while (now >= hr_tick_tsc)
+    {
+      timer_tick ();
+      hr_tick_tsc += tick_tsc;
+      ticked = true;
+    }
+  hrtimer_expire (now);
+
+  if (!heap_empty (&hrtimers)
+      && (heap_entry (heap_min (&hrtimers), struct hrtimer, elem)->deadline
+          < hr_tick_tsc))
+    hrtimer_program (heap_entry (heap_min (&hrtimers),
+                                 struct hrtimer, elem)->deadline);
+  else if (ticked)
+    {
+      /* We are on a tick boundary with nothing to do before the
+         next one, so the periodic timer can take over again. */
+      hr_oneshot = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  else
+    hrtimer_program (hr_tick_tsc);
+}
+
+/* Programs the PIT to interrupt once at time-stamp counter value
+   DEADLINE, or at the next tick boundary if that is earlier. */
+static void
+hrtimer_program (uint64_t deadline)
+{
+  uint64_t now = rdtsc ();
+  uint64_t cycles;
+
+  if (deadline > hr_tick_tsc)
+    deadline = hr_tick_tsc;
+  hr_event_tsc = deadline;
+
+  /* Round up, so as not to interrupt before DEADLINE. */
+  cycles = (deadline > now
+            ? DIV_ROUND_UP ((deadline - now) * PIT_HZ, tsc_hz)
+            : 0);
+  if (cycles < HR_MIN_CYCLES)
+    cycles = HR_MIN_CYCLES;
+  if (cycles > 65535)
+    cycles = 65535;
+  pit_start_oneshot (0, cycles);
+}
+
+/* Converts NUM/DENOM seconds into time-stamp counter cycles,
+   taking care not to overflow. */
+static uint64_t
+to_tsc (int64_t num, int32_t denom)
+{
+  return num / denom * tsc_hz + num % denom * tsc_hz / denom;
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
 static void
 real_time_sleep(int64_t num, int32_t denom)
 {
-  /* Convert NUM/DENOM seconds into timer ticks, rounding down.
-        (NUM / DENOM) s
-     ---------------------- = NUM * TIMER_FREQ / DENOM ticks.
-     1 s / TIMER_FREQ ticks
-  */
-  int64_t ticks = num * TIMER_FREQ / denom;
-
   ASSERT(intr_get_level() == INTR_ON);
-  if (ticks > 0)
-  {
-    /* We're waiting for at least one full timer tick.  Use
-       timer_sleep() because it will yield the CPU to other
-       processes. */
-    timer_sleep(ticks);
-  }
-  else
+  if (num <= 0)
+    return;
+
+  if (tsc_hz == 0)
   {
-    /* Otherwise, use a busy-wait loop for more accurate
-       sub-tick timing. */
-    real_time_delay(num, denom);
+    /* Not calibrated yet, so round up to whole ticks. */
+    timer_sleep(DIV_ROUND_UP(num * TIMER_FREQ, denom));
+    return;
   }
+  hrtimer_sleep(rdtsc() + to_tsc(num, denom));
 }
 
-/* Busy-wait for approximately NUM/DENOM seconds. */
+/* Busy-wait for approximately NUM/DENOM seconds.  Does not wait
+   at all before timer_calibrate() has run. */
 static void
 real_time_delay(int64_t num, int32_t denom)
 {
-  /* Scale the numerator and denominator down by 1000 to avoid
-     the possibility of overflow. */
-  ASSERT(denom % 1000 == 0);
-  busy_wait(loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+  uint64_t end;
+
+  if (num <= 0)
+    return;
+  end = rdtsc() + to_tsc(num, denom);
+  while (rdtsc() < end)
+    barrier();
 }
\ No newline at end of file
@@ -2,16 +2,24 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
-/* Number of timer interrupts per second. */
-#define TIMER_FREQ 100
+/* Number of timer interrupts per second.  The default may be
+   overridden with the "-hz" kernel command-line option, within
+   the range the 8254 timer supports. */
+#define TIMER_FREQ_DEFAULT 100
+#define TIMER_FREQ_MIN 19
+#define TIMER_FREQ_MAX 1000
+extern int timer_freq;
+#define TIMER_FREQ timer_freq
 
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -25,5 +33,12 @@ void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
+void timer_reset_intr_stats (void);
+void timer_get_intr_stats (uint64_t *avg_cycles, uint64_t *max_cycles);
+
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
 
 #endif /* devices/timer.h */
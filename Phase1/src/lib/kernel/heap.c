@@ -0,0 +1,184 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Our pairing heap is a multiway tree kept in heap order: no
+   element compares less than its parent.  The root is therefore
+   the minimum element.  Each element points to its leftmost
+   child, and the children of an element form a doubly linked
+   list through `next' and `prev', except that the leftmost
+   child's `prev' points to the parent instead.
+
+   Insertion just links the new element with the root.  Removing
+   the root merges its children back together in two passes:
+   first adjacent pairs are linked from left to right, then the
+   resulting trees are linked from right to left.  This keeps the
+   tree shallow enough for O(log n) amortized removal.  Both
+   passes are iterative, so removal never recurses, which matters
+   because heaps are manipulated on small kernel stacks and in
+   interrupt handlers. */
+
+static struct heap_elem *link (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes HEAP as an empty heap that orders its elements
+   using LESS given auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->elem_cnt = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = link (heap, heap->root, elem);
+  heap->elem_cnt++;
+}
+
+/* Removes and returns the minimum element of HEAP, which must
+   not be empty. */
+struct heap_elem *
+heap_pop_min (struct heap *heap)
+{
+  struct heap_elem *min;
+
+  ASSERT (!heap_empty (heap));
+
+  min = heap->root;
+  heap->root = merge_pairs (heap, min->child);
+  heap->elem_cnt--;
+  min->child = NULL;
+  return min;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  struct heap_elem *subtree;
+
+  ASSERT (!heap_empty (heap));
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    {
+      heap_pop_min (heap);
+      return;
+    }
+
+  /* Unlink ELEM and its subtree from its siblings. */
+  ASSERT (elem->prev != NULL);
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+
+  /* Merge ELEM's children and put them back. */
+  subtree = merge_pairs (heap, elem->child);
+  heap->root = link (heap, heap->root, subtree);
+  heap->elem_cnt--;
+  elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Returns the minimum element of HEAP, which must not be
+   empty. */
+struct heap_elem *
+heap_min (struct heap *heap)
+{
+  ASSERT (!heap_empty (heap));
+  return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->elem_cnt;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->root == NULL;
+}
+
+/* Links the trees rooted at A and B, either of which may be
+   null, by making the greater root the leftmost child of the
+   lesser one.  Returns the root of the combined tree. */
+static struct heap_elem *
+link (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (heap->less (b, a, heap->aux))
+    {
+      struct heap_elem *temp = a;
+      a = b;
+      b = temp;
+    }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Combines the sibling list beginning at FIRST into a single
+   tree using the two-pass pairing strategy and returns its root,
+   or a null pointer if FIRST is null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* Left-to-right pass.  The linked pairs are chained through
+     `prev' in reverse order, ready for the second pass. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+
+      a = link (heap, a, b);
+      a->prev = pairs;
+      pairs = a;
+    }
+
+  /* Right-to-left pass. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *a = pairs;
+
+      pairs = a->prev;
+      a->prev = NULL;
+      root = link (heap, root, a);
+    }
+  return root;
+}
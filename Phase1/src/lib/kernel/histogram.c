@@ -0,0 +1,84 @@
+#include "histogram.h"
+#include <stdio.h>
+#include <string.h>
+#include "../debug.h"
+
+/* Width of the longest bar printed by histogram_print(). */
+#define BAR_WIDTH 40
+
+/* Returns the bucket for VALUE, the index of its most
+   significant 1 bit. */
+static int
+bucket_of (uint64_t value)
+{
+  int bucket = 0;
+
+  while (value > 1)
+    {
+      value >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* Initializes HIST as an empty histogram.  A histogram in static
+   storage is already empty. */
+void
+histogram_init (struct histogram *hist)
+{
+  ASSERT (hist != NULL);
+  memset (hist, 0, sizeof *hist);
+}
+
+/* Adds VALUE to HIST. */
+void
+histogram_add (struct histogram *hist, uint64_t value)
+{
+  hist->buckets[bucket_of (value)]++;
+  hist->cnt++;
+  hist->sum += value;
+  if (value > hist->max)
+    hist->max = value;
+}
+
+/* Prints HIST to the console as a summary line headed by TITLE
+   followed by one line per bucket, from the first nonempty bucket
+   to the last, each line starting with PREFIX. */
+void
+histogram_print (const struct histogram *hist, const char *prefix,
+                 const char *title)
+{
+  uint64_t most = 0;
+  int first, last, i;
+
+  printf ("%s%s: %llu samples", prefix, title,
+          (unsigned long long) hist->cnt);
+  if (hist->cnt == 0)
+    {
+      printf ("\n");
+      return;
+    }
+  printf (", average %llu, max %llu\n",
+          (unsigned long long) (hist->sum / hist->cnt),
+          (unsigned long long) hist->max);
+
+  for (first = 0; hist->buckets[first] == 0; first++)
+    continue;
+  for (last = HISTOGRAM_BUCKETS - 1; hist->buckets[last] == 0; last--)
+    continue;
+  for (i = first; i <= last; i++)
+    if (hist->buckets[i] > most)
+      most = hist->buckets[i];
+
+  for (i = first; i <= last; i++)
+    {
+      int bar = hist->buckets[i] * BAR_WIDTH / most;
+      int j;
+
+      printf ("%s  < 2^%-2d %10llu ", prefix, i + 1,
+              (unsigned long long) hist->buckets[i]);
+      for (j = 0; j < bar; j++)
+        putchar ('*');
+      putchar ('\n');
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef __LIB_KERNEL_HISTOGRAM_H
+#define __LIB_KERNEL_HISTOGRAM_H
+
+/* Log2 histogram.
+
+   Counts samples in buckets whose bounds are powers of 2: bucket
+   0 holds samples of 0 and 1, and bucket B, for B > 0, holds
+   samples in [2**B, 2**(B+1)).  Adding a sample takes constant
+   time and the histogram never allocates memory, so it can be
+   used anywhere in the kernel, including interrupt handlers, as
+   long as the caller serializes access to it. */
+
+#include <stdint.h>
+
+#define HISTOGRAM_BUCKETS 64
+
+struct histogram
+  {
+    uint64_t buckets[HISTOGRAM_BUCKETS]; /* Sample counts. */
+    uint64_t cnt;                       /* Number of samples. */
+    uint64_t sum;                       /* Sum of samples. */
+    uint64_t max;                       /* Largest sample. */
+  };
+
+void histogram_init (struct histogram *);
+void histogram_add (struct histogram *, uint64_t value);
+void histogram_print (const struct histogram *, const char *prefix,
+                      const char *title);
+
+#endif /* lib/kernel/histogram.h */
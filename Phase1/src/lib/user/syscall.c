@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void
+nsleep (int64_t ns) 
+{
+  syscall2 (SYS_NSLEEP, (uint32_t) ns, (uint32_t) (ns >> 32));
+}
@@ -33,6 +33,25 @@ sub check_expected {
     compare_output ("run", @options, \@output, $expected);
 }
 
+# Checks the output of a benchmark, whose numbers differ from run to
+# run.  Each of @PATTERNS must match some line the test printed, with
+# the "(test-name) " prefix stripped, and the test must have passed.
+sub check_benchmark {
+    my (@patterns) = @_;
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+
+    my ($name) = $test =~ m%([^/]+)$%;
+    my (@lines) = map (/^\(\Q$name\E\) (.*)$/ ? $1 : (), @output);
+    for my $pattern (@patterns) {
+	fail "missing line matching $pattern in output\n"
+	  unless grep (/$pattern/, @lines);
+    }
+    fail "missing PASS in output\n" unless grep ($_ eq 'PASS', @lines);
+    pass;
+}
+
 sub common_checks {
     my ($run, @output) = @_;
 
@@ -0,0 +1,116 @@
+/* Runs two periodic real-time threads in the earliest-deadline-
+   first class against several spinning threads at the highest
+   priority, and checks that every job meets its deadline.
+
+   The real-time threads claim half of the CPU between them, so
+   their deadlines can be met only if they run ahead of the
+   spinners whenever they have work to do.  Also checks that
+   admission control turns away a thread that would claim more
+   of the CPU than the class may have. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define EDF_CNT 2
+#define SPINNER_CNT 4
+
+/* A periodic real-time thread's parameters, in timer ticks. */
+struct edf_params
+  {
+    int64_t runtime;
+    int64_t period;
+    int64_t deadline;
+    int job_cnt;
+  };
+
+static const struct edf_params params[EDF_CNT] =
+  {
+    {3, 10, 10, 30},
+    {3, 20, 15, 15},
+  };
+
+static struct semaphore done;
+static int finished;
+static int total_misses;
+
+static void edf_thread (void *aux);
+static void spinner_thread (void *aux);
+
+void
+test_edf_deadline (void)
+{
+  int jobs = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (thread_set_deadline (4, 10, 3))
+    fail ("accepted a deadline shorter than the runtime");
+  if (thread_set_deadline (4, 3, 10))
+    fail ("accepted a deadline longer than the period");
+  if (thread_set_deadline (10, 10, 10))
+    fail ("admitted a thread that claims the whole CPU");
+  msg ("Admission control rejected over-subscription.");
+
+  /* Create everything at the highest priority, so that each
+     thread gets going without preempting the main thread. */
+  sema_init (&done, 0);
+  thread_set_priority (PRI_MAX);
+  for (i = 0; i < EDF_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "edf %d", i);
+      thread_create (name, PRI_MAX, edf_thread, (void *) &params[i]);
+      jobs += params[i].job_cnt;
+    }
+  for (i = 0; i < SPINNER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "spin %d", i);
+      thread_create (name, PRI_MAX, spinner_thread, NULL);
+    }
+
+  for (i = 0; i < EDF_CNT; i++)
+    sema_down (&done);
+  thread_set_priority (PRI_DEFAULT);
+
+  msg ("%d jobs, %d deadline misses.", jobs, total_misses);
+  if (total_misses != 0)
+    fail ("real-time threads missed deadlines under load");
+}
+
+static void
+edf_thread (void *params_)
+{
+  const struct edf_params *p = params_;
+  int i;
+
+  if (!thread_set_deadline (p->runtime, p->period, p->deadline))
+    fail ("could not admit %s", thread_name ());
+
+  /* Each job spins until one timer tick has passed, well within
+     its budget. */
+  for (i = 0; i < p->job_cnt; i++)
+    {
+      int64_t start = timer_ticks ();
+      while (timer_ticks () == start)
+        continue;
+      thread_deadline_yield ();
+    }
+
+  total_misses += thread_get_deadline_misses ();
+  finished++;
+  sema_up (&done);
+}
+
+static void
+spinner_thread (void *aux UNUSED)
+{
+  while (finished < EDF_CNT)
+    barrier ();
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-deadline) begin
+(edf-deadline) Admission control rejected over-subscription.
+(edf-deadline) 45 jobs, 0 deadline misses.
+(edf-deadline) end
+EOF
+pass;
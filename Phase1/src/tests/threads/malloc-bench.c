@@ -0,0 +1,102 @@
+/* Measures malloc() and free() with several threads making a
+   random mix of small allocations at once.
+
+   Each thread fills every block it allocates with a pattern of
+   its own and checks the pattern before freeing the block, so
+   the test fails if two live blocks ever overlap.  Prints the
+   average cost of an allocation or free in time-stamp counter
+   cycles.  The numbers are for comparison between kernels. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4
+#define SLOT_CNT 32
+#define MAX_SIZE 256
+#define OP_CNT 20000
+
+static struct semaphore done;
+static int failures;
+
+static thread_func churn_thread;
+
+void
+test_malloc_bench (void)
+{
+  uint64_t start, cycles;
+  int ops = THREAD_CNT * OP_CNT;
+  int i;
+
+  sema_init (&done, 0);
+  start = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "churn %d", i);
+      if (thread_create (name, PRI_DEFAULT, churn_thread,
+                         (void *) (i + 1)) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  cycles = rdtsc () - start;
+
+  msg ("%d operations, %"PRIu64" cycles per operation, %d failed.",
+       ops, cycles / ops, failures);
+  pass ();
+}
+
+/* Allocates and frees random blocks, marking each with byte
+   value AUX. */
+static void
+churn_thread (void *aux)
+{
+  int id = (int) aux;
+  unsigned char *blocks[SLOT_CNT];
+  size_t sizes[SLOT_CNT];
+  unsigned seed = id;
+  int i;
+
+  memset (blocks, 0, sizeof blocks);
+  for (i = 0; i < OP_CNT; i++)
+    {
+      int slot;
+
+      seed = seed * 1103515245 + 12345;
+      slot = (seed >> 16) % SLOT_CNT;
+      if (blocks[slot] != NULL)
+        {
+          size_t j;
+
+          for (j = 0; j < sizes[slot]; j++)
+            if (blocks[slot][j] != id)
+              fail ("block overwritten in thread %d", id);
+          free (blocks[slot]);
+          blocks[slot] = NULL;
+        }
+      else
+        {
+          seed = seed * 1103515245 + 12345;
+          sizes[slot] = (seed >> 16) % MAX_SIZE + 1;
+          blocks[slot] = malloc (sizes[slot]);
+          if (blocks[slot] != NULL)
+            memset (blocks[slot], id, sizes[slot]);
+          else
+            failures++;
+        }
+      if (i % 1000 == 0)
+        thread_yield ();
+    }
+
+  for (i = 0; i < SLOT_CNT; i++)
+    free (blocks[i]);
+  sema_up (&done);
+}
@@ -0,0 +1,93 @@
+/* Has several threads make a random mix of small allocations at
+   once, each from a fixed seed of its own.
+
+   Each thread fills every block it allocates with a pattern of
+   its own and checks the pattern before freeing the block, so
+   the test fails if two live blocks ever overlap.  Each thread
+   exits with blocks still cached in its magazines, which must be
+   given back without disturbing the other threads. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4
+#define SLOT_CNT 32
+#define MAX_SIZE 256
+#define OP_CNT 5000
+
+static struct semaphore done;
+
+static thread_func churn_thread;
+
+void
+test_malloc_churn (void)
+{
+  int i;
+
+  sema_init (&done, 0);
+  msg ("Starting %d threads.", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "churn %d", i);
+      if (thread_create (name, PRI_DEFAULT, churn_thread,
+                         (void *) (i + 1)) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  msg ("All threads finished.");
+}
+
+/* Allocates and frees random blocks, marking each with byte
+   value AUX. */
+static void
+churn_thread (void *aux)
+{
+  int id = (int) aux;
+  unsigned char *blocks[SLOT_CNT];
+  size_t sizes[SLOT_CNT];
+  unsigned seed = id;
+  int i;
+
+  memset (blocks, 0, sizeof blocks);
+  for (i = 0; i < OP_CNT; i++)
+    {
+      int slot;
+
+      seed = seed * 1103515245 + 12345;
+      slot = (seed >> 16) % SLOT_CNT;
+      if (blocks[slot] != NULL)
+        {
+          size_t j;
+
+          for (j = 0; j < sizes[slot]; j++)
+            if (blocks[slot][j] != id)
+              fail ("block overwritten in thread %d", id);
+          free (blocks[slot]);
+          blocks[slot] = NULL;
+        }
+      else
+        {
+          seed = seed * 1103515245 + 12345;
+          sizes[slot] = (seed >> 16) % MAX_SIZE + 1;
+          blocks[slot] = malloc (sizes[slot]);
+          if (blocks[slot] == NULL)
+            fail ("thread %d could not allocate %zu bytes",
+                  id, sizes[slot]);
+          memset (blocks[slot], id, sizes[slot]);
+        }
+      if (i % 1000 == 0)
+        thread_yield ();
+    }
+
+  for (i = 0; i < SLOT_CNT; i++)
+    free (blocks[i]);
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-churn) begin
+(malloc-churn) Starting 4 threads.
+(malloc-churn) All threads finished.
+(malloc-churn) end
+EOF
+pass;
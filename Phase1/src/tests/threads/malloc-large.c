@@ -0,0 +1,91 @@
+/* Checks malloc() and realloc() with blocks of 2 kB and more.
+
+   Fills a few arenas' worth of blocks in each large size,
+   checking that no two overlap.  Then checks that realloc()
+   keeps a block in place while its size still fits, moves it
+   with its contents when it does not, and grows and shrinks a
+   block bigger than the largest size in place. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+
+#define BLOCK_CNT 12
+
+static void fill (unsigned char *, size_t size, int value);
+static void check (const unsigned char *, size_t size, int value);
+
+void
+test_malloc_large (void)
+{
+  static const size_t sizes[] = {2100, 3000, 5000, 10000};
+  unsigned char *blocks[BLOCK_CNT];
+  unsigned char *p, *q;
+  uintptr_t addr;
+  size_t i, j;
+
+  msg ("Allocating large blocks.");
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      for (j = 0; j < BLOCK_CNT; j++)
+        {
+          blocks[j] = malloc (sizes[i]);
+          if (blocks[j] == NULL)
+            fail ("could not allocate %zu bytes", sizes[i]);
+          fill (blocks[j], sizes[i], j);
+        }
+      for (j = 0; j < BLOCK_CNT; j++)
+        {
+          check (blocks[j], sizes[i], j);
+          free (blocks[j]);
+        }
+    }
+
+  msg ("Resizing a large block.");
+  p = malloc (2500);
+  fill (p, 2500, 1);
+  addr = (uintptr_t) p;
+  p = realloc (p, 3072);
+  if ((uintptr_t) p != addr)
+    fail ("block moved though the new size fits");
+  q = realloc (p, 5000);
+  if (q == NULL)
+    fail ("could not grow block");
+  check (q, 2500, 1);
+  free (q);
+
+  msg ("Resizing a page run.");
+  p = malloc (20000);
+  fill (p, 20000, 2);
+  addr = (uintptr_t) p;
+  p = realloc (p, 24000);
+  if ((uintptr_t) p != addr)
+    fail ("page run moved though the next page is free");
+  check (p, 20000, 2);
+  p = realloc (p, 14000);
+  if ((uintptr_t) p != addr)
+    fail ("page run moved while shrinking");
+  check (p, 14000, 2);
+  free (p);
+}
+
+/* Fills the SIZE bytes at P with VALUE. */
+static void
+fill (unsigned char *p, size_t size, int value)
+{
+  memset (p, value, size);
+}
+
+/* Checks that the SIZE bytes at P all equal VALUE. */
+static void
+check (const unsigned char *p, size_t size, int value)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != (unsigned char) value)
+      fail ("byte %zu of block is %d, expected %d", i, p[i], value);
+}
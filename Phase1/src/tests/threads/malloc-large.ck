@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-large) begin
+(malloc-large) Allocating large blocks.
+(malloc-large) Resizing a large block.
+(malloc-large) Resizing a page run.
+(malloc-large) end
+EOF
+pass;
@@ -0,0 +1,85 @@
+/* Measures how long the timer interrupt handler takes with
+   THREAD_CNT threads in the system under the multi-level
+   feedback queue scheduler.
+
+   Most of the threads sleep for the whole measurement, so they
+   only cost anything in the once-a-second recent_cpu update.  A
+   few spin at different nice values along with the main thread,
+   so that the run queue holds several priorities while the
+   per-slice and per-second recomputations run.  Prints the
+   average and worst-case handler cost in time-stamp counter
+   cycles.  The numbers are for comparison between kernels; the
+   test only fails if threads cannot be created. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define SPINNER_CNT 10
+#define MEASURE_SECONDS 5
+
+static int64_t end_time;
+static struct semaphore done;
+
+static void sleeper_thread (void *aux);
+static void spinner_thread (void *aux);
+
+void
+test_mlfqs_tick_cost (void)
+{
+  uint64_t avg_cycles, max_cycles;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&done, 0);
+  end_time = timer_ticks () + (MEASURE_SECONDS + 5) * TIMER_FREQ;
+
+  msg ("Starting %d threads...", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      bool spinner = i < SPINNER_CNT;
+
+      snprintf (name, sizeof name, "%s %d", spinner ? "spin" : "sleep", i);
+      if (thread_create (name, PRI_DEFAULT,
+                         spinner ? spinner_thread : sleeper_thread,
+                         (void *) i) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+
+  msg ("Measuring for %d seconds...", MEASURE_SECONDS);
+  timer_reset_intr_stats ();
+  while (timer_ticks () < end_time - 5 * TIMER_FREQ)
+    continue;
+  timer_get_intr_stats (&avg_cycles, &max_cycles);
+  msg ("%d threads: %"PRIu64" cycles per timer interrupt on average, "
+       "%"PRIu64" at most.", THREAD_CNT, avg_cycles, max_cycles);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  pass ();
+}
+
+static void
+sleeper_thread (void *aux UNUSED)
+{
+  timer_sleep (end_time - timer_ticks ());
+  sema_up (&done);
+}
+
+static void
+spinner_thread (void *aux)
+{
+  int i = (int) aux;
+
+  thread_set_nice (i % (NICE_MAX + 1));
+  while (timer_ticks () < end_time)
+    continue;
+  sema_up (&done);
+}
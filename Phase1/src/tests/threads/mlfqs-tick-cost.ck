@@ -0,0 +1,5 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_benchmark (qr/^\d+ threads: \d+ cycles per timer interrupt/);
@@ -0,0 +1,92 @@
+/* Measures the page allocator under a random mix of multi-page
+   allocations and frees in the user pool, which a threads
+   kernel does not otherwise use.
+
+   Prints the average cost of an allocation or free in time-stamp
+   counter cycles, and how fragmented the pool is afterward: the
+   largest block that can still be allocated with half of the
+   allocations live.  Then frees everything and checks that the
+   largest block is as large as it was at the start, which fails
+   if freed pages are not merged back together.  The numbers are
+   for comparison between kernels. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+
+#define SLOT_CNT 64
+#define MAX_PAGES 8
+#define OP_CNT 100000
+
+static void *pages[SLOT_CNT];
+static size_t page_cnts[SLOT_CNT];
+
+static size_t largest_block (void);
+
+void
+test_palloc_bench (void)
+{
+  size_t initial, fragmented, final;
+  uint64_t start, cycles;
+  int ops = 0, failures = 0;
+  int i;
+
+  initial = largest_block ();
+  msg ("Largest block at start: %zu pages.", initial);
+
+  random_init (0);
+  start = rdtsc ();
+  for (i = 0; i < OP_CNT; i++)
+    {
+      int slot = random_ulong () % SLOT_CNT;
+
+      if (pages[slot] != NULL)
+        {
+          palloc_free_multiple (pages[slot], page_cnts[slot]);
+          pages[slot] = NULL;
+        }
+      else
+        {
+          page_cnts[slot] = random_ulong () % MAX_PAGES + 1;
+          pages[slot] = palloc_get_multiple (PAL_USER, page_cnts[slot]);
+          if (pages[slot] == NULL)
+            failures++;
+        }
+      ops++;
+    }
+  cycles = rdtsc () - start;
+  msg ("%d operations, %"PRIu64" cycles per operation, %d failed.",
+       ops, cycles / ops, failures);
+
+  fragmented = largest_block ();
+  msg ("Largest block with allocations live: %zu pages.", fragmented);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (pages[i] != NULL)
+      palloc_free_multiple (pages[i], page_cnts[i]);
+  final = largest_block ();
+  if (final < initial)
+    fail ("largest block shrank from %zu to %zu pages after freeing "
+          "everything", initial, final);
+  pass ();
+}
+
+/* Returns the size of the largest power-of-2 block of pages that
+   can be allocated from the user pool. */
+static size_t
+largest_block (void)
+{
+  size_t page_cnt;
+
+  for (page_cnt = 1; ; page_cnt *= 2)
+    {
+      void *p = palloc_get_multiple (PAL_USER, page_cnt);
+      if (p == NULL)
+        return page_cnt / 2;
+      palloc_free_multiple (p, page_cnt);
+    }
+}
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_benchmark (qr/^\d+ operations, \d+ cycles per operation, \d+ failed\.$/,
+		 qr/^Largest block with allocations live: \d+ pages\.$/);
@@ -0,0 +1,90 @@
+/* Allocates and frees runs of pages from the user pool in a fixed
+   random order, filling each run with a pattern and checking it
+   is intact when the run is freed, which fails if two live runs
+   overlap.  Then frees everything and checks that the largest
+   block that can be allocated is as large as it was at the start,
+   which fails if freed pages are not merged back together. */
+
+#include <stdio.h>
+#include <string.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define SLOT_CNT 64
+#define MAX_PAGES 8
+#define OP_CNT 10000
+
+static void *pages[SLOT_CNT];
+static size_t page_cnts[SLOT_CNT];
+
+static size_t largest_block (void);
+static void free_slot (int slot);
+
+void
+test_palloc_coalesce (void)
+{
+  size_t initial, final;
+  int i;
+
+  initial = largest_block ();
+
+  msg ("Allocating and freeing runs of pages at random.");
+  random_init (0);
+  for (i = 0; i < OP_CNT; i++)
+    {
+      int slot = random_ulong () % SLOT_CNT;
+
+      if (pages[slot] != NULL)
+        free_slot (slot);
+      else
+        {
+          page_cnts[slot] = random_ulong () % MAX_PAGES + 1;
+          pages[slot] = palloc_get_multiple (PAL_USER, page_cnts[slot]);
+          if (pages[slot] != NULL)
+            memset (pages[slot], slot, page_cnts[slot] * PGSIZE);
+        }
+    }
+
+  msg ("Freeing everything.");
+  for (i = 0; i < SLOT_CNT; i++)
+    if (pages[i] != NULL)
+      free_slot (i);
+
+  final = largest_block ();
+  if (final < initial)
+    fail ("largest block shrank from %zu to %zu pages after freeing "
+          "everything", initial, final);
+}
+
+/* Checks the pattern in the run of pages in SLOT and frees it. */
+static void
+free_slot (int slot)
+{
+  const unsigned char *p = pages[slot];
+  size_t i;
+
+  for (i = 0; i < page_cnts[slot] * PGSIZE; i++)
+    if (p[i] != slot)
+      fail ("run in slot %d overwritten at byte %zu", slot, i);
+  palloc_free_multiple (pages[slot], page_cnts[slot]);
+  pages[slot] = NULL;
+}
+
+/* Returns the size of the largest power-of-2 block of pages that
+   can be allocated from the user pool. */
+static size_t
+largest_block (void)
+{
+  size_t page_cnt;
+
+  for (page_cnt = 1; ; page_cnt *= 2)
+    {
+      void *p = palloc_get_multiple (PAL_USER, page_cnt);
+      if (p == NULL)
+        return page_cnt / 2;
+      palloc_free_multiple (p, page_cnt);
+    }
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-coalesce) begin
+(palloc-coalesce) Allocating and freeing runs of pages at random.
+(palloc-coalesce) Freeing everything.
+(palloc-coalesce) end
+EOF
+pass;
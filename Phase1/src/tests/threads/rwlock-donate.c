@@ -0,0 +1,64 @@
+/* The main thread takes an rwlock for reading, and a writer
+   that has to wait for it donates its priority to the main
+   thread.  Then a higher-priority reader blocks behind the
+   writer, donating its priority to the writer, which passes it
+   on to the main thread.  Once the main thread lets go of the
+   rwlock, the writer and then the reader get it, and the main
+   thread is back at its own priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_func;
+static thread_func reader_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_read_acquire (&rw);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_func, &rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  thread_create ("reader", PRI_DEFAULT + 2, reader_func, &rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  rwlock_read_release (&rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+writer_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_write_acquire (rw);
+  msg ("writer: got write access.");
+  msg ("Writer should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  rwlock_write_release (rw);
+  msg ("writer: done.");
+}
+
+static void
+reader_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_read_acquire (rw);
+  msg ("reader: got read access.");
+  rwlock_read_release (rw);
+  msg ("reader: done.");
+}
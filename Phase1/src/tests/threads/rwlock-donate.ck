@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) Main thread should have priority 32.  Actual priority: 32.
+(rwlock-donate) Main thread should have priority 33.  Actual priority: 33.
+(rwlock-donate) writer: got write access.
+(rwlock-donate) Writer should have priority 33.  Actual priority: 33.
+(rwlock-donate) reader: got read access.
+(rwlock-donate) reader: done.
+(rwlock-donate) writer: done.
+(rwlock-donate) Main thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* The main thread takes an rwlock for reading.  A second reader
+   gets in alongside it.  Then a writer arrives and has to wait,
+   and a reader that arrives after the writer has to wait behind
+   it, even though it could share the lock with the main thread,
+   so that a steady stream of readers cannot starve writers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_a_func;
+static thread_func writer_func;
+static thread_func reader_b_func;
+
+void
+test_rwlock_fair (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_read_acquire (&rw);
+  thread_create ("reader a", PRI_DEFAULT + 1, reader_a_func, &rw);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_func, &rw);
+  thread_create ("reader b", PRI_DEFAULT + 2, reader_b_func, &rw);
+  msg ("main: releasing read access.");
+  rwlock_read_release (&rw);
+  msg ("main: done.");
+}
+
+static void
+reader_a_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_read_acquire (rw);
+  msg ("reader a: got read access alongside main.");
+  rwlock_read_release (rw);
+  msg ("reader a: done.");
+}
+
+static void
+writer_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_write_acquire (rw);
+  msg ("writer: got write access.");
+  rwlock_write_release (rw);
+  msg ("writer: done.");
+}
+
+static void
+reader_b_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_read_acquire (rw);
+  msg ("reader b: got read access.");
+  rwlock_read_release (rw);
+  msg ("reader b: done.");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-fair) begin
+(rwlock-fair) reader a: got read access alongside main.
+(rwlock-fair) reader a: done.
+(rwlock-fair) main: releasing read access.
+(rwlock-fair) writer: got write access.
+(rwlock-fair) reader b: got read access.
+(rwlock-fair) reader b: done.
+(rwlock-fair) writer: done.
+(rwlock-fair) main: done.
+(rwlock-fair) end
+EOF
+pass;
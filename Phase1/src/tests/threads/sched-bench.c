@@ -0,0 +1,122 @@
+/* Measures what the timer frequency and time slice cost and buy:
+   how many context switches per second SPINNER_CNT CPU-bound
+   threads of equal priority go through, how much work they get
+   done, and how long a thread of the same priority that wakes up
+   every tick waits before it runs.
+
+   Run it with different "-hz" and "-slice" kernel options to
+   compare settings, e.g.
+     make tests/threads/sched-bench.result KERNELFLAGS="-hz=1000 -slice=2"
+   The numbers are for comparison between settings; the test
+   only fails if threads cannot be created. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPINNER_CNT 4
+#define MEASURE_SECONDS 5
+
+static int64_t end_time;
+static struct semaphore done;
+static long long switches;
+static uint64_t spins;
+static uint64_t wakeups, wakeup_cycles, max_wakeup_cycles;
+
+static void spinner_thread (void *aux);
+static void sleeper_thread (void *aux);
+
+void
+test_sched_bench (void)
+{
+  int64_t start_ns, ns;
+  uint64_t start_tsc, tsc;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("%d Hz timer, %d-tick time slice.", TIMER_FREQ, thread_time_slice);
+
+  /* Start measuring on a tick boundary. */
+  sema_init (&done, 0);
+  end_time = timer_ticks ();
+  while (timer_ticks () == end_time)
+    continue;
+  end_time += 1 + MEASURE_SECONDS * TIMER_FREQ;
+  start_ns = timer_ns ();
+  start_tsc = rdtsc ();
+
+  msg ("Measuring for %d seconds...", MEASURE_SECONDS);
+  for (i = 0; i < SPINNER_CNT; i++)
+    if (thread_create ("spin", PRI_DEFAULT, spinner_thread, NULL)
+        == TID_ERROR)
+      fail ("could not create thread %d", i);
+  if (thread_create ("sleep", PRI_DEFAULT, sleeper_thread, NULL)
+      == TID_ERROR)
+    fail ("could not create sleeper thread");
+  for (i = 0; i < SPINNER_CNT + 1; i++)
+    sema_down (&done);
+
+  /* Convert cycles to nanoseconds at the TSC rate seen over the
+     measurement. */
+  ns = timer_ns () - start_ns;
+  tsc = rdtsc () - start_tsc;
+  msg ("%lld context switches per second.", switches / MEASURE_SECONDS);
+  msg ("%"PRIu64" spins per second.", spins / MEASURE_SECONDS);
+  if (wakeups == 0)
+    fail ("sleeper never woke up");
+  msg ("%"PRIu64" wakeups, %"PRIu64" ns average latency, %"PRIu64" ns at most.",
+       wakeups, wakeup_cycles / wakeups * ns / tsc,
+       max_wakeup_cycles * ns / tsc);
+  pass ();
+}
+
+static void
+spinner_thread (void *aux UNUSED)
+{
+  uint64_t cnt = 0;
+  enum intr_level old_level;
+
+  while (timer_ticks () < end_time)
+    cnt++;
+
+  old_level = intr_disable ();
+  spins += cnt;
+  switches += thread_current ()->acct.involuntary_switches;
+  intr_set_level (old_level);
+  sema_up (&done);
+}
+
+/* Sleeps a tick at a time, and measures how long it waits to run
+   after the timer interrupt makes it ready, which is the time
+   recorded in its `ready_tsc'. */
+static void
+sleeper_thread (void *aux UNUSED)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  while (timer_ticks () < end_time)
+    {
+      uint64_t cycles;
+
+      timer_sleep (1);
+      cycles = rdtsc () - cur->ready_tsc;
+      wakeup_cycles += cycles;
+      if (cycles > max_wakeup_cycles)
+        max_wakeup_cycles = cycles;
+      wakeups++;
+    }
+
+  old_level = intr_disable ();
+  switches += cur->acct.voluntary_switches + cur->acct.involuntary_switches;
+  intr_set_level (old_level);
+  sema_up (&done);
+}
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_benchmark (qr/^\d+ context switches per second\.$/,
+		 qr/^\d+ wakeups, \d+ ns average latency, \d+ ns at most\.$/);
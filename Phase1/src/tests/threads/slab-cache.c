@@ -0,0 +1,112 @@
+/* Checks the slab allocator with objects the size of an inode.
+
+   Fills three slabs, checking that every object was constructed
+   and that no two overlap, and that consecutive slabs are given
+   different colors.  Then frees everything and allocates a
+   slab's worth of objects again, which should reuse the one
+   empty slab the cache keeps, without constructing its objects
+   a second time. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define SLAB_CNT 3
+#define MAX_OBJS 64
+
+/* Marks a constructed object. */
+#define OBJ_MAGIC 0x0b1ec7ed
+
+struct obj
+  {
+    unsigned magic;             /* OBJ_MAGIC once constructed. */
+    unsigned char data[556];    /* Filled in by the test. */
+  };
+
+static struct slab_cache cache;
+static struct obj *objs[MAX_OBJS];
+static int ctor_cnt;
+
+static void construct (void *);
+static void check_objects (size_t cnt);
+
+void
+test_slab_cache (void)
+{
+  size_t cnt, i;
+
+  slab_cache_init (&cache, "slab-cache", sizeof (struct obj), construct);
+  cnt = SLAB_CNT * cache.obj_cnt;
+  ASSERT (cnt <= MAX_OBJS);
+  if (cache.color_cnt < 2)
+    fail ("no room to color %zu-byte objects", cache.obj_size);
+
+  msg ("Allocating %d slabs of objects.", SLAB_CNT);
+  check_objects (cnt);
+  if (ctor_cnt != (int) cnt)
+    fail ("constructed %d objects, expected %zu", ctor_cnt, cnt);
+  if (cache.slab_cnt != SLAB_CNT)
+    fail ("cache has %zu slabs, expected %d", cache.slab_cnt, SLAB_CNT);
+  for (i = 0; i + cache.obj_cnt < cnt; i += cache.obj_cnt)
+    if (pg_ofs (objs[i]) == pg_ofs (objs[i + cache.obj_cnt]))
+      fail ("consecutive slabs have the same color");
+
+  msg ("Freeing them.");
+  for (i = 0; i < cnt; i++)
+    slab_free (&cache, objs[i]);
+  if (cache.in_use != 0 || cache.slab_cnt != 1)
+    fail ("%zu objects in %zu slabs left after freeing all",
+          cache.in_use, cache.slab_cnt);
+
+  msg ("Allocating a slab of objects again.");
+  check_objects (cache.obj_cnt);
+  if (ctor_cnt != (int) cnt)
+    fail ("constructed %d objects, expected %zu", ctor_cnt, cnt);
+  if (cache.slab_cnt != 1)
+    fail ("cache has %zu slabs, expected 1", cache.slab_cnt);
+
+  for (i = 0; i < cache.obj_cnt; i++)
+    slab_free (&cache, objs[i]);
+  slab_cache_destroy (&cache);
+}
+
+/* Allocates CNT objects into OBJS, checking that each one is
+   constructed and that none overlap. */
+static void
+check_objects (size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      objs[i] = slab_alloc (&cache);
+      if (objs[i] == NULL)
+        fail ("allocation %zu failed", i);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %zu was not constructed", i);
+      memset (objs[i]->data, i, sizeof objs[i]->data);
+    }
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j;
+
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %zu was overwritten", i);
+      for (j = 0; j < sizeof objs[i]->data; j++)
+        if (objs[i]->data[j] != (unsigned char) i)
+          fail ("object %zu was overwritten", i);
+    }
+}
+
+/* Constructs the object at OBJ_. */
+static void
+construct (void *obj_)
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocating 3 slabs of objects.
+(slab-cache) Freeing them.
+(slab-cache) Allocating a slab of objects again.
+(slab-cache) end
+EOF
+pass;
@@ -29,6 +29,18 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"rwlock-fair", test_rwlock_fair},
+    {"rwlock-donate", test_rwlock_donate},
+    {"thread-churn", test_thread_churn},
+    {"thread-cache-exhaust", test_thread_cache_exhaust},
+    {"edf-deadline", test_edf_deadline},
+    {"sched-bench", test_sched_bench},
+    {"palloc-bench", test_palloc_bench},
+    {"palloc-coalesce", test_palloc_coalesce},
+    {"slab-cache", test_slab_cache},
+    {"malloc-bench", test_malloc_bench},
+    {"malloc-churn", test_malloc_churn},
+    {"malloc-large", test_malloc_large},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +50,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-tick-cost", test_mlfqs_tick_cost},
   };
 
 static const char *test_name;
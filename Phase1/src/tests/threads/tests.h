@@ -23,6 +23,18 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_rwlock_fair;
+extern test_func test_rwlock_donate;
+extern test_func test_thread_churn;
+extern test_func test_thread_cache_exhaust;
+extern test_func test_edf_deadline;
+extern test_func test_sched_bench;
+extern test_func test_palloc_bench;
+extern test_func test_palloc_coalesce;
+extern test_func test_slab_cache;
+extern test_func test_malloc_bench;
+extern test_func test_malloc_churn;
+extern test_func test_malloc_large;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +44,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_tick_cost;
 void msg (const char *, ...);
 void fail (const char *, ...);
 void pass (void);
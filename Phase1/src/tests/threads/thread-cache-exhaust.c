@@ -0,0 +1,62 @@
+/* Exhausts the kernel pool, then lets a thread exit, so that its
+   page goes into the cache of dead thread pages while no other
+   page is free.  The idle thread must not keep taking that page
+   back out of the cache to refill the cache, which would hang
+   the kernel with interrupts off. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static struct semaphore go, done;
+
+static thread_func exit_thread;
+
+void
+test_thread_cache_exhaust (void)
+{
+  void *pages = NULL;
+  void *page;
+  int cnt = 0;
+
+  sema_init (&go, 0);
+  sema_init (&done, 0);
+  if (thread_create ("exiter", PRI_DEFAULT, exit_thread, NULL)
+      == TID_ERROR)
+    fail ("could not create thread");
+
+  /* Chain the pages together through their first word. */
+  msg ("Exhausting the kernel pool.");
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = pages;
+      pages = page;
+      cnt++;
+    }
+  if (cnt == 0)
+    fail ("no kernel pages to allocate");
+
+  msg ("Letting a thread exit.");
+  sema_up (&go);
+  sema_down (&done);
+  timer_sleep (10);
+  msg ("Still running.");
+
+  while (pages != NULL)
+    {
+      page = pages;
+      pages = *(void **) page;
+      palloc_free_page (page);
+    }
+}
+
+static void
+exit_thread (void *aux UNUSED)
+{
+  sema_down (&go);
+  sema_up (&done);
+}
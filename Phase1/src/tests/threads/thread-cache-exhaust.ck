@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-cache-exhaust) begin
+(thread-cache-exhaust) Exhausting the kernel pool.
+(thread-cache-exhaust) Letting a thread exit.
+(thread-cache-exhaust) Still running.
+(thread-cache-exhaust) end
+EOF
+pass;
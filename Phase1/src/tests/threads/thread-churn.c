@@ -0,0 +1,50 @@
+/* Measures how many short-lived threads can be created and
+   destroyed per second.
+
+   Each thread is created at a higher priority than the main
+   thread, so it runs and exits before thread_create() returns,
+   and the next thread_create() can reuse its page.  The number
+   is for comparison between kernels; the test only fails if a
+   thread cannot be created. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MEASURE_SECONDS 5
+
+static void exit_thread (void *aux);
+
+void
+test_thread_churn (void)
+{
+  int64_t start, end_time;
+  int cnt = 0;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Start measuring on a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  end_time = start + 1 + MEASURE_SECONDS * TIMER_FREQ;
+
+  msg ("Measuring for %d seconds...", MEASURE_SECONDS);
+  while (timer_ticks () < end_time)
+    {
+      if (thread_create ("churn", PRI_DEFAULT + 1, exit_thread, NULL)
+          == TID_ERROR)
+        fail ("could not create thread %d", cnt);
+      cnt++;
+    }
+  msg ("%d thread create/exit pairs per second.", cnt / MEASURE_SECONDS);
+  pass ();
+}
+
+static void
+exit_thread (void *aux UNUSED)
+{
+}
@@ -0,0 +1,5 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_benchmark (qr/^\d+ thread create\/exit pairs per second\.$/);
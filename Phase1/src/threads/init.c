@@ -20,8 +20,10 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -110,6 +112,7 @@ main (void)
   timer_init ();
   kbd_init ();
   input_init ();
+  profile_init ();
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
@@ -256,6 +259,37 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-hz"))
+        {
+          timer_freq = value != NULL ? atoi (value) : 0;
+          if (timer_freq < TIMER_FREQ_MIN || timer_freq > TIMER_FREQ_MAX)
+            PANIC ("timer frequency must be between %d and %d Hz",
+                   TIMER_FREQ_MIN, TIMER_FREQ_MAX);
+        }
+      else if (!strcmp (name, "-slice"))
+        {
+          thread_time_slice = value != NULL ? atoi (value) : 0;
+          if (thread_time_slice < 1)
+            PANIC ("time slice must be at least 1 tick");
+        }
+      else if (!strcmp (name, "-o"))
+        {
+          /* Accept both "-o=NAME" and "-o NAME". */
+          if (value == NULL && argv[1] != NULL)
+            value = *++argv;
+          if (value == NULL)
+            PANIC ("option `-o' requires an argument (use -h for help)");
+          else if (!strcmp (value, "trace"))
+            trace_enabled = true;
+          else if (!strcmp (value, "intr-off"))
+            intr_profile = true;
+          else if (!strcmp (value, "profile"))
+            profile_enabled = true;
+          else if (!strcmp (value, "tickless"))
+            timer_tickless = true;
+          else
+            PANIC ("unknown option `-o %s' (use -h for help)", value);
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -379,6 +413,12 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -hz=FREQ           Interrupt FREQ times per second (default 100).\n"
+          "  -slice=TICKS       Give each thread TICKS ticks at a time (default 4).\n"
+          "  -o trace           Print the scheduler event trace at shutdown.\n"
+          "  -o intr-off        Profile how long interrupts stay off.\n"
+          "  -o profile         Sample where the CPU spends its time.\n"
+          "  -o tickless        Stop the timer tick while the CPU is idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
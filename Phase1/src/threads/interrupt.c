@@ -1,8 +1,10 @@
 #include "threads/interrupt.h"
 #include <debug.h>
+#include <histogram.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
@@ -47,6 +49,32 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Interrupts-off profiling.  When enabled by the "-o intr-off"
+   kernel option, every stretch of time with interrupts off is
+   timed with the time-stamp counter, from the intr_disable() or
+   intr_set_level() call that turned them off, or the entry to an
+   interrupt handler, until intr_enable() or intr_set_level()
+   turns them back on or the external interrupt handler returns.
+   Durations go into a histogram, and the worst one seen for each
+   call site competes for a place in a list of the INTR_TOP_CNT
+   worst sites. */
+bool intr_profile;
+#define INTR_TOP_CNT 10
+static uint64_t off_start;      /* When interrupts went off, or 0. */
+static void *off_site;          /* Where interrupts went off. */
+static struct histogram off_hist;
+static struct off_entry
+  {
+    void *site;                 /* Call site, or null if unused. */
+    uint64_t cycles;            /* Worst duration seen there. */
+    uint64_t cnt;               /* Times it was in the list. */
+  }
+off_top[INTR_TOP_CNT];
+
+static enum intr_level disable (void *site);
+static void off_begin (void *site);
+static void off_end (void);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -80,7 +108,9 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  return (level == INTR_ON
+          ? intr_enable ()
+          : disable (__builtin_return_address (0)));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -90,6 +120,9 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (intr_profile && old_level == INTR_OFF)
+    off_end ();
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -102,6 +135,14 @@ intr_enable (void)
 /* Disables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_disable (void) 
+{
+  return disable (__builtin_return_address (0));
+}
+
+/* Disables interrupts on behalf of the caller at SITE and
+   returns the previous interrupt status. */
+static enum intr_level
+disable (void *site) 
 {
   enum intr_level old_level = intr_get_level ();
 
@@ -110,8 +151,98 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (intr_profile && old_level == INTR_ON)
+    off_begin (site);
+
   return old_level;
 }
+
+/* Notes that interrupts just went off at SITE. */
+static void
+off_begin (void *site) 
+{
+  off_start = rdtsc ();
+  off_site = site;
+}
+
+/* Notes that interrupts are about to go back on, and records how
+   long they were off.  Does nothing if we did not see them go
+   off, which happens when a thread that turned them off switched
+   to a thread that turned them on with `iret'. */
+static void
+off_end (void) 
+{
+  uint64_t cycles;
+  struct off_entry *min;
+  int i;
+
+  if (off_start == 0)
+    return;
+  cycles = rdtsc () - off_start;
+  off_start = 0;
+  histogram_add (&off_hist, cycles);
+
+  /* Keep the worst duration for each site in OFF_TOP.  If the
+     site is not there yet, it replaces the least bad entry. */
+  min = &off_top[0];
+  for (i = 0; i < INTR_TOP_CNT; i++) 
+    {
+      struct off_entry *s = &off_top[i];
+      if (s->site == off_site) 
+        {
+          s->cnt++;
+          if (cycles > s->cycles)
+            s->cycles = cycles;
+          return;
+        }
+      if (s->cycles < min->cycles)
+        min = s;
+    }
+  if (cycles > min->cycles) 
+    {
+      min->site = off_site;
+      min->cycles = cycles;
+      min->cnt = 1;
+    }
+}
+
+/* Prints the interrupts-off profile, if profiling is enabled:
+   the worst call sites, worst first, and a histogram of all
+   durations.  The call sites are return addresses that the
+   backtrace utility can translate into functions and line
+   numbers. */
+void
+intr_print_stats (void) 
+{
+  struct off_entry top[INTR_TOP_CNT];
+  struct histogram hist;
+  enum intr_level old_level;
+  int i, j;
+
+  if (!intr_profile)
+    return;
+
+  /* Take a snapshot, since printing turns interrupts off too. */
+  old_level = intr_disable ();
+  memcpy (top, off_top, sizeof top);
+  hist = off_hist;
+  intr_set_level (old_level);
+
+  /* Sort worst first. */
+  for (i = 1; i < INTR_TOP_CNT; i++)
+    for (j = i; j > 0 && top[j].cycles > top[j - 1].cycles; j--) 
+      {
+        struct off_entry temp = top[j];
+        top[j] = top[j - 1];
+        top[j - 1] = temp;
+      }
+
+  printf ("Interrupts: worst interrupts-off sections:\n");
+  for (i = 0; i < INTR_TOP_CNT && top[i].site != NULL; i++)
+    printf ("Interrupts:   %p: %"PRIu64" cycles (%"PRIu64" times in list)\n",
+            top[i].site, top[i].cycles, top[i].cnt);
+  histogram_print (&hist, "Interrupts: ", "cycles with interrupts off");
+}
 
 /* Initializes the interrupt system. */
 void
@@ -363,6 +494,9 @@ intr_handler (struct intr_frame *frame)
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
+  if (intr_profile && intr_get_level () == INTR_OFF
+      && (frame->eflags & FLAG_IF))
+    off_begin (handler);
   if (handler != NULL)
     handler (frame);
   else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
@@ -382,6 +516,8 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no); 
+      if (intr_profile)
+        off_end ();
 
       if (yield_on_return) 
         thread_yield (); 
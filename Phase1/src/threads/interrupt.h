@@ -64,6 +64,10 @@ void intr_register_int (uint8_t vec, int dpl, enum intr_level,
 bool intr_context (void);
 void intr_yield_on_return (void);
 
+/* Interrupts-off profiling. */
+extern bool intr_profile;
+void intr_print_stats (void);
+
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
@@ -5,8 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -28,19 +31,38 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Blocks of 2 kB and more don't fit more than once in a page
+   with an arena header, so a few larger "large" sizes, which
+   need not be powers of 2, have arenas of several pages whose
+   header is allocated separately, with malloc().  PAGE_MAP
+   records the arena header for each page of such an arena.
+
+   We handle blocks bigger than the largest size by allocating
+   contiguous pages with the page allocator and sticking the
+   allocation size at the beginning of the allocated block's
+   arena header.  realloc() grows such a block in place when
+   the pages just past it are free, and shrinks it in place by
+   freeing its tail.
+
+   Each thread also keeps a "magazine" of free blocks for each of
+   the smallest sizes.  free() puts a block into the current
+   thread's magazine and malloc() takes it back out, without
+   locking anything, since no other thread touches the magazine.
+   An empty magazine is refilled with half a magazine's worth of
+   blocks under a single acquisition of the descriptor's lock, and
+   a full one is flushed back by half the same way.  Blocks in
+   magazines still count as in use in their arenas.  A thread's
+   magazines are flushed when it exits. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t arena_pages;         /* Pages in a large arena, or 0. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    char name[16];              /* Lock name, e.g. "malloc 16". */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -52,6 +74,21 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    uint8_t *blocks;            /* First block. */
+  };
+
+/* Large block sizes, and the number of pages in each arena. */
+static const struct
+  {
+    size_t block_size;
+    size_t arena_pages;
+  }
+large_sizes[] =
+  {
+    {2048, 1},
+    {3072, 3},
+    {6144, 3},
+    {12288, 3},
   };
 
 /* Free block. */
@@ -61,9 +98,17 @@ struct block
   };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[16];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Arena header for each page of physical memory that is part of
+   a large arena, indexed by page number, otherwise null. */
+static struct arena **page_map;
+
+static void init_desc (size_t block_size, size_t arena_pages);
+static bool resize_in_place (void *, size_t new_size);
+static struct block *get_block (struct desc *);
+static void put_block (struct desc *, struct block *);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -72,16 +117,40 @@ void
 malloc_init (void) 
 {
   size_t block_size;
+  size_t i;
 
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
-    {
-      struct desc *d = &descs[desc_cnt++];
-      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-      d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-      list_init (&d->free_list);
-      lock_init (&d->lock);
-    }
+    init_desc (block_size, 0);
+  ASSERT (desc_cnt >= MALLOC_MAG_CLASSES);
+  for (i = 0; i < sizeof large_sizes / sizeof *large_sizes; i++)
+    init_desc (large_sizes[i].block_size, large_sizes[i].arena_pages);
+
+  page_map = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                  DIV_ROUND_UP (init_ram_pages
+                                                * sizeof *page_map,
+                                                PGSIZE));
+}
+
+/* Initializes a descriptor for blocks of BLOCK_SIZE bytes, in
+   one-page arenas if ARENA_PAGES is 0, otherwise in large arenas
+   of ARENA_PAGES pages. */
+static void
+init_desc (size_t block_size, size_t arena_pages) 
+{
+  struct desc *d = &descs[desc_cnt++];
+
+  ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+  ASSERT (desc_cnt == 1 || d[-1].block_size < block_size);
+  d->block_size = block_size;
+  d->arena_pages = arena_pages;
+  if (arena_pages == 0)
+    d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+  else
+    d->blocks_per_arena = arena_pages * PGSIZE / block_size;
+  ASSERT (d->blocks_per_arena > 0);
+  list_init (&d->free_list);
+  snprintf (d->name, sizeof d->name, "malloc %zu", block_size);
+  lock_init_named (&d->lock, d->name);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -92,6 +161,7 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct malloc_magazine *m;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -116,41 +186,36 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      a->blocks = (uint8_t *) (a + 1);
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  if (d - descs >= MALLOC_MAG_CLASSES)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
+      lock_acquire (&d->lock);
+      b = get_block (d);
+      lock_release (&d->lock);
+      return b;
+    }
 
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
+  /* Refill the magazine if it is empty. */
+  ASSERT (!intr_context ());
+  m = &thread_current ()->mags[d - descs];
+  if (m->cnt == 0)
+    {
+      lock_acquire (&d->lock);
+      while (m->cnt < MALLOC_MAG_ROUNDS / 2)
         {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
+          b = get_block (d);
+          if (b == NULL)
+            break;
+          m->blocks[m->cnt++] = b;
         }
+      lock_release (&d->lock);
+      if (m->cnt == 0)
+        return NULL;
     }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
-  return b;
+  return m->blocks[--m->cnt];
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -199,6 +264,8 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    return old_block;
   else 
     {
       void *new_block = malloc (new_size);
@@ -213,6 +280,36 @@ realloc (void *old_block, size_t new_size)
     }
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   Returns true if successful, false if BLOCK must move. */
+static bool
+resize_in_place (void *block, size_t new_size) 
+{
+  struct arena *a = block_to_arena (block);
+  struct desc *d = a->desc;
+  size_t page_cnt;
+
+  /* A normal block stays put as long as NEW_SIZE still needs a
+     block of its size. */
+  if (d != NULL)
+    return new_size <= d->block_size
+           && (d == descs || new_size > d[-1].block_size);
+
+  /* A big block that would now fit a descriptor must move. */
+  if (new_size <= descs[desc_cnt - 1].block_size)
+    return false;
+
+  page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  if (page_cnt < a->free_cnt)
+    palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+                          a->free_cnt - page_cnt);
+  else if (page_cnt > a->free_cnt
+           && !palloc_extend (a, a->free_cnt, page_cnt))
+    return false;
+  a->free_cnt = page_cnt;
+  return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
@@ -227,32 +324,32 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct malloc_magazine *m;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          if (d - descs >= MALLOC_MAG_CLASSES)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              lock_acquire (&d->lock);
+              put_block (d, b);
+              lock_release (&d->lock);
+              return;
             }
 
-          lock_release (&d->lock);
+          /* Flush half of the magazine if it is full. */
+          ASSERT (!intr_context ());
+          m = &thread_current ()->mags[d - descs];
+          if (m->cnt == MALLOC_MAG_ROUNDS)
+            {
+              lock_acquire (&d->lock);
+              while (m->cnt > MALLOC_MAG_ROUNDS / 2)
+                put_block (d, m->blocks[--m->cnt]);
+              lock_release (&d->lock);
+            }
+          m->blocks[m->cnt++] = b;
         }
       else
         {
@@ -263,11 +360,129 @@ free (void *p)
     }
 }
 
+/* Returns the blocks in the running thread's magazines to their
+   arenas.  Called by thread_exit(). */
+void
+malloc_thread_exit (void) 
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  for (i = 0; i < MALLOC_MAG_CLASSES; i++)
+    {
+      struct malloc_magazine *m = &t->mags[i];
+
+      if (m->cnt > 0)
+        {
+          lock_acquire (&descs[i].lock);
+          while (m->cnt > 0)
+            put_block (&descs[i], m->blocks[--m->cnt]);
+          lock_release (&descs[i].lock);
+        }
+    }
+}
+
+/* Takes a block from D's free list, creating a new arena if the
+   list is empty, and returns it.  Returns a null pointer if
+   memory is not available.  D's lock must be held. */
+static struct block *
+get_block (struct desc *d) 
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      if (d->arena_pages == 0)
+        {
+          /* Allocate a page. */
+          a = palloc_get_page (0);
+          if (a == NULL) 
+            return NULL; 
+          a->blocks = (uint8_t *) (a + 1);
+        }
+      else
+        {
+          /* Allocate a large arena and its header. */
+          a = malloc (sizeof *a);
+          if (a == NULL)
+            return NULL;
+          a->blocks = palloc_get_multiple (0, d->arena_pages);
+          if (a->blocks == NULL)
+            {
+              free (a);
+              return NULL;
+            }
+          for (i = 0; i < d->arena_pages; i++)
+            page_map[(vtop (a->blocks) >> PGBITS) + i] = a;
+        }
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Returns block B to D's free list, freeing its arena if that
+   leaves the arena entirely unused.  D's lock must be held. */
+static void
+put_block (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      if (d->arena_pages == 0)
+        palloc_free_page (a);
+      else
+        {
+          for (i = 0; i < d->arena_pages; i++)
+            page_map[(vtop (a->blocks) >> PGBITS) + i] = NULL;
+          palloc_free_multiple (a->blocks, d->arena_pages);
+          free (a);
+        }
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
 {
-  struct arena *a = pg_round_down (b);
+  struct arena *a = page_map[vtop (b) >> PGBITS];
+
+  if (a == NULL)
+    a = pg_round_down (b);
 
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
@@ -275,7 +490,7 @@ block_to_arena (struct block *b)
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || ((uint8_t *) b - a->blocks) % a->desc->block_size == 0);
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -288,7 +503,5 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a != NULL);
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
-  return (struct block *) ((uint8_t *) a
-                           + sizeof *a
-                           + idx * a->desc->block_size);
+  return (struct block *) (a->blocks + idx * a->desc->block_size);
 }
@@ -4,10 +4,23 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Per-thread cache of free blocks of one size, so that most
+   malloc() and free() calls need not take the descriptor's lock.
+   Only the smallest MALLOC_MAG_CLASSES sizes, 16 through 128
+   bytes, have magazines. */
+#define MALLOC_MAG_CLASSES 4
+#define MALLOC_MAG_ROUNDS 8
+struct malloc_magazine
+  {
+    size_t cnt;                         /* Number of blocks. */
+    void *blocks[MALLOC_MAG_ROUNDS];    /* Free blocks, last in first out. */
+  };
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_thread_exit (void);
 
 #endif /* threads/malloc.h */
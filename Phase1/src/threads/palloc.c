@@ -2,13 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +25,69 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed by a binary buddy allocator.  The pool is
+   carved into blocks of 2**ORDER pages, each aligned, relative to
+   the pool's base, to a multiple of its size, and the free blocks
+   of each order are kept on a list linked through their first
+   pages.  An allocation takes the smallest free block big enough
+   for it, splitting larger blocks in half as needed, and gives
+   back any pages past the end of the request.  Freeing a block
+   whose buddy, the other half of the block one order up, is also
+   free merges the two, and so on up.  Both take O(log n) time,
+   and free memory stays in blocks as large as it can.
+
+   That is short enough to do with interrupts off, so allocating
+   and freeing never sleep and may be done by the scheduler and
+   the idle thread.
+
+   Each pool also keeps a few single pages that are already
+   zeroed, so that a PAL_ZERO page request does not have to clear
+   4 kB on the spot.  Once a pool has fewer than ZERO_LOW of them,
+   the idle thread zeroes more, up to ZERO_HIGH, as long as the
+   pool has free pages to spare.  A request that cannot otherwise
+   be met gets the zeroed pages back. */
+
+/* Number of block orders.  The largest block is 2**(ORDER_CNT-1)
+   pages, 2 GB. */
+#define ORDER_CNT 20
+
+/* Watermarks for each pool's zeroed pages. */
+#define ZERO_LOW 8
+#define ZERO_HIGH 32
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *orders;                    /* Free block orders, see below. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+    size_t free_cnt;                    /* Pages in FREE_LISTS. */
+    struct list zeroed;                 /* Zeroed pages, allocated. */
+    size_t zeroed_cnt;                  /* Pages in ZEROED. */
     uint8_t *base;                      /* Base of pool. */
   };
 
+/* ORDERS has one byte per page: for the first page of a free
+   block of order K, K + 1, and otherwise 0. */
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t take_pages (struct pool *, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static void release_zeroed (struct pool *);
+static void zero_refill (struct pool *);
+static size_t elem_block (const struct pool *, struct list_elem *);
+static int order_for (size_t page_cnt);
+static size_t alloc_block (struct pool *, int order);
+static void free_block (struct pool *, size_t page_idx, int order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void take_range (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -66,33 +115,55 @@ palloc_init (size_t user_page_limit)
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.  Before giving up on
+   the kernel pool, takes back the pages cached for new threads,
+   unless PAL_NOCACHE is set.
+   Never sleeps, so it may be called with interrupts off. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  bool zeroed = false;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  old_level = intr_disable ();
+  if (page_cnt == 1 && (flags & PAL_ZERO) && pool->zeroed_cnt > 0)
+    {
+      pages = take_zeroed (pool);
+      zeroed = true;
+    }
   else
-    pages = NULL;
+    {
+      page_idx = take_pages (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+        {
+          release_zeroed (pool);
+          page_idx = take_pages (pool, page_cnt);
+        }
+      if (page_idx != BITMAP_ERROR)
+        pages = pool->base + PGSIZE * page_idx;
+      else
+        pages = NULL;
+    }
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
     {
+      /* Retry once, and only if the drain left enough pages. */
+      if (pool == &kernel_pool && !(flags & PAL_NOCACHE)
+          && thread_cache_drain ()
+          && pool->free_cnt + pool->zeroed_cnt >= page_cnt)
+        return palloc_get_multiple (flags | PAL_NOCACHE, page_cnt);
       if (flags & PAL_ASSERT)
         PANIC ("palloc_get: out of pages");
     }
@@ -113,11 +184,13 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
-/* Frees the PAGE_CNT pages starting at PAGES. */
+/* Frees the PAGE_CNT pages starting at PAGES.  Never sleeps, so
+   it may be called with interrupts off. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +210,53 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  free_range (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
+}
+
+/* Extends the PAGE_CNT pages starting at PAGES, which must have
+   been allocated together, to NEW_CNT pages, if the pages just
+   past them are free.  Returns true if successful, false if the
+   allocation is left as it was. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt) 
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t page_idx;
+  bool success = false;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_cnt >= page_cnt);
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  page_idx = pg_no (pages) - pg_no (pool->base);
+
+  old_level = intr_disable ();
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  if (page_idx + new_cnt <= bitmap_size (pool->used_map)
+      && bitmap_none (pool->used_map, page_idx + page_cnt,
+                      new_cnt - page_cnt))
+    {
+      take_range (pool, page_idx + page_cnt, new_cnt - page_cnt);
+      bitmap_set_multiple (pool->used_map, page_idx + page_cnt,
+                           new_cnt - page_cnt, true);
+      pool->free_cnt -= new_cnt - page_cnt;
+      success = true;
+    }
+  intr_set_level (old_level);
+
+  return success;
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +266,45 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Called by the idle thread, with interrupts on, to zero free
+   pages for later PAL_ZERO requests. */
+void
+palloc_zero_refill (void)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  zero_refill (&kernel_pool);
+  zero_refill (&user_pool);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map and orders at its base.
+     Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  /* Initialize the pool, with all of its pages free. */
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->orders = (uint8_t *) base + bm_size;
+  memset (p->orders, 0, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
   p->base = base + bm_pages * PGSIZE;
+  free_range (p, 0, page_cnt);
+  p->free_cnt = page_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +318,229 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Allocates PAGE_CNT contiguous pages from POOL's free lists and
+   returns the index of the first, or BITMAP_ERROR if there is no
+   free block big enough.  Interrupts must be off. */
+static size_t
+take_pages (struct pool *pool, size_t page_cnt)
+{
+  int order = order_for (page_cnt);
+  size_t page_idx;
+
+  if (order >= ORDER_CNT)
+    return BITMAP_ERROR;
+  page_idx = alloc_block (pool, order);
+  if (page_idx != BITMAP_ERROR)
+    {
+      /* Give back the pages past the end of the request. */
+      free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+      ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+      pool->free_cnt -= page_cnt;
+    }
+  return page_idx;
+}
+
+/* Removes a page from POOL's zeroed pages and returns it, all
+   zeros.  Interrupts must be off, and POOL must have a
+   zeroed page. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  struct list_elem *e = list_pop_front (&pool->zeroed);
+
+  pool->zeroed_cnt--;
+  memset (e, 0, sizeof *e);
+  return e;
+}
+
+/* Returns all of POOL's zeroed pages to its free lists.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *pool)
+{
+  while (!list_empty (&pool->zeroed))
+    {
+      size_t page_idx = elem_block (pool, list_pop_front (&pool->zeroed));
+
+      bitmap_reset (pool->used_map, page_idx);
+      free_block (pool, page_idx, 0);
+      pool->free_cnt++;
+    }
+  pool->zeroed_cnt = 0;
+}
+
+/* Zeroes free pages in POOL until it has ZERO_HIGH of them, if it
+   has fewer than ZERO_LOW.  Leaves at least ZERO_HIGH pages free,
+   for allocations that the zeroed pages cannot serve.  Pages are
+   cleared with interrupts on, so a thread woken meanwhile does
+   not have to wait. */
+static void
+zero_refill (struct pool *pool)
+{
+  if (pool->zeroed_cnt >= ZERO_LOW)
+    return;
+
+  while (pool->zeroed_cnt < ZERO_HIGH)
+    {
+      enum intr_level old_level;
+      size_t page_idx = BITMAP_ERROR;
+      uint8_t *page;
+
+      old_level = intr_disable ();
+      if (pool->free_cnt > ZERO_HIGH)
+        page_idx = take_pages (pool, 1);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        break;
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      list_push_front (&pool->zeroed, (struct list_elem *) page);
+      pool->zeroed_cnt++;
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns the free list element kept in the first page of the
+   block in POOL that starts at page PAGE_IDX. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the first page of the block in POOL whose
+   free list element is ELEM. */
+static size_t
+elem_block (const struct pool *pool, struct list_elem *elem)
+{
+  return pg_no (elem) - pg_no (pool->base);
+}
+
+/* Returns the order of the smallest block that holds PAGE_CNT
+   pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Removes a free block of 2**ORDER pages from POOL, splitting a
+   larger one if there is none that size, and returns the index
+   of its first page, or BITMAP_ERROR if no block is big enough.
+   Interrupts must be off. */
+static size_t
+alloc_block (struct pool *pool, int order)
+{
+  size_t page_idx;
+  int k;
+
+  for (k = order; k < ORDER_CNT; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k == ORDER_CNT)
+    return BITMAP_ERROR;
+
+  page_idx = elem_block (pool, list_pop_front (&pool->free_lists[k]));
+  pool->orders[page_idx] = 0;
+
+  /* Put the upper halves back until the block is the right
+     size. */
+  while (k > order)
+    {
+      size_t buddy;
+
+      k--;
+      buddy = page_idx + ((size_t) 1 << k);
+      pool->orders[buddy] = k + 1;
+      list_push_front (&pool->free_lists[k], block_elem (pool, buddy));
+    }
+  return page_idx;
+}
+
+/* Returns the block of 2**ORDER pages starting at PAGE_IDX to
+   POOL's free lists, merging it with its buddy as long as that
+   is free too.  Interrupts must be off. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  for (; order < ORDER_CNT - 1; order++)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > page_cnt
+          || pool->orders[buddy] != order + 1)
+        break;
+      list_remove (block_elem (pool, buddy));
+      pool->orders[buddy] = 0;
+      if (buddy < page_idx)
+        page_idx = buddy;
+    }
+  pool->orders[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Returns the PAGE_CNT pages starting at PAGE_IDX to POOL's free
+   lists, as the fewest aligned blocks that cover them.
+   Interrupts must be off. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order < ORDER_CNT - 1
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Removes the PAGE_CNT pages starting at PAGE_IDX, which must all
+   be free, from POOL's free lists, splitting the blocks that hold
+   them and giving back the parts outside the range.  Interrupts
+   must be off. */
+static void
+take_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      size_t start, block_end, take_end;
+      int order;
+
+      /* Free blocks are aligned to their size, so the one that
+         holds PAGE_IDX starts at PAGE_IDX rounded down to some
+         power of 2. */
+      for (order = 0; order < ORDER_CNT; order++)
+        {
+          start = page_idx & ~(((size_t) 1 << order) - 1);
+          if (pool->orders[start] == order + 1)
+            break;
+        }
+      ASSERT (order < ORDER_CNT);
+
+      list_remove (block_elem (pool, start));
+      pool->orders[start] = 0;
+      block_end = start + ((size_t) 1 << order);
+      take_end = block_end < end ? block_end : end;
+      free_range (pool, start, page_idx - start);
+      free_range (pool, take_end, block_end - take_end);
+      page_idx = take_end;
+    }
+}
@@ -0,0 +1,130 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/rtc.h"
+
+/* Samples are counted in a hash table keyed on the interrupted
+   instruction's address and, for user code, the thread running
+   it, since user programs share virtual addresses.  Kernel
+   samples are counted without regard to the thread.  The table
+   is allocated statically, so that taking a sample never
+   allocates memory and never fails; samples that find the table
+   full are only counted as dropped.
+
+   profile_print() prints one line per address, most frequent
+   first, in the form
+        Profile: COUNT PERCENT% ADDRESS [THREAD]
+   Kernel addresses can be turned into function names by passing
+   the ADDRESS column to utils/backtrace, e.g.
+        backtrace kernel.o $(awk '/^Profile: .*%/ {print $4}' OUTPUT)
+   and user addresses likewise with the user program's binary. */
+
+/* Number of slots in the table.  Must be a power of 2. */
+#define PROFILE_SLOTS 4096
+
+/* Number of lines printed by profile_print(). */
+#define PROFILE_PRINT_CNT 64
+
+/* A slot in the table. */
+struct profile_slot
+  {
+    uintptr_t eip;              /* Address, or 0 if slot is unused. */
+    tid_t tid;                  /* Thread for user addresses, else 0. */
+    unsigned cnt;               /* Number of samples. */
+  };
+
+bool profile_enabled;
+static struct profile_slot slots[PROFILE_SLOTS];
+static uint64_t sample_cnt;     /* Samples taken. */
+static uint64_t dropped_cnt;    /* Samples that found no free slot. */
+
+static void profile_interrupt (struct intr_frame *);
+static int compare_slots (const void *, const void *);
+
+/* Starts sampling, if profiling was requested.  Must be called
+   after the interrupt system is initialized. */
+void
+profile_init (void)
+{
+  if (profile_enabled)
+    rtc_start_periodic (profile_interrupt);
+}
+
+/* Takes a sample of interrupted frame F. */
+static void
+profile_interrupt (struct intr_frame *f)
+{
+  uintptr_t eip = (uintptr_t) f->eip;
+  tid_t tid = is_user_vaddr ((void *) eip) ? thread_current ()->tid : 0;
+  unsigned hash = (eip ^ (eip >> 12) ^ tid) * 2654435761u;
+  int i;
+
+  if (!profile_enabled)
+    return;
+
+  sample_cnt++;
+  for (i = 0; i < PROFILE_SLOTS; i++)
+    {
+      struct profile_slot *s = &slots[(hash + i) % PROFILE_SLOTS];
+      if (s->eip == eip && s->tid == tid)
+        {
+          s->cnt++;
+          return;
+        }
+      else if (s->eip == 0)
+        {
+          s->eip = eip;
+          s->tid = tid;
+          s->cnt = 1;
+          return;
+        }
+    }
+  dropped_cnt++;
+}
+
+/* Prints the profile, if profiling is enabled.  Stops sampling,
+   since it sorts the table in place. */
+void
+profile_print (void)
+{
+  enum intr_level old_level;
+  int i;
+
+  if (!profile_enabled)
+    return;
+
+  old_level = intr_disable ();
+  profile_enabled = false;
+  intr_set_level (old_level);
+  qsort (slots, PROFILE_SLOTS, sizeof *slots, compare_slots);
+
+  printf ("Profile: %"PRIu64" samples at %d Hz, %"PRIu64" dropped\n",
+          sample_cnt, RTC_PERIODIC_HZ, dropped_cnt);
+  for (i = 0; i < PROFILE_PRINT_CNT && slots[i].cnt > 0; i++)
+    {
+      const struct profile_slot *s = &slots[i];
+      unsigned permille = s->cnt * 1000ull / sample_cnt;
+
+      printf ("Profile: %8u %3u.%u%% 0x%08"PRIxPTR, s->cnt,
+              permille / 10, permille % 10, s->eip);
+      if (s->tid != 0)
+        printf (" user thread %d", s->tid);
+      printf ("\n");
+    }
+}
+
+/* Orders profile slots by decreasing count. */
+static int
+compare_slots (const void *a_, const void *b_)
+{
+  const struct profile_slot *a = a_;
+  const struct profile_slot *b = b_;
+
+  return a->cnt < b->cnt ? 1 : a->cnt > b->cnt ? -1 : 0;
+}
@@ -0,0 +1,18 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+/* Sampling profiler.
+
+   When the "-o profile" kernel option is given, the RTC
+   interrupts RTC_PERIODIC_HZ times per second, and each time we
+   note where the interrupted code was.  At shutdown,
+   profile_print() prints how often each address was seen. */
+
+extern bool profile_enabled;
+
+void profile_init (void);
+void profile_print (void);
+
+#endif /* threads/profile.h */
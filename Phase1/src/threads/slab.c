@@ -0,0 +1,284 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator, after Bonwick's.
+
+   Each cache carves one-page "slabs" into objects of its size.
+   A slab starts with a header that records which of its objects
+   are free, as a linked list of object indexes, so free objects
+   keep their constructed contents.  malloc() instead rounds each
+   request up to a power of 2, which for a 560-byte inode wastes
+   nearly half of every block.
+
+   The cache allocates from a partly used slab if it has one, so
+   that objects stay packed into few pages.  When a slab's last
+   object is freed the slab is kept for reuse, but only one
+   empty slab per cache: the rest go back to the page allocator.
+
+   Objects of the same size in different slabs would all start
+   at the same page offsets, and so compete for the same cache
+   sets.  The space left over at the end of each slab is used to
+   "color" them: each new slab starts its objects SLAB_COLOR
+   bytes further in than the previous one, wrapping around when
+   the leftover space runs out. */
+
+/* Alignment of objects. */
+#define SLAB_ALIGN 8
+
+/* Distance between slab colors, a cache line. */
+#define SLAB_COLOR 64
+
+/* Marks the end of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x534c4142
+
+/* Slab header, at the start of the slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's slab list. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Objects in use. */
+    uint16_t free;              /* First free object, or SLAB_END. */
+    uint16_t next[];            /* Next free object after each one. */
+  };
+
+/* List of all caches. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static size_t header_size (size_t obj_cnt);
+static struct slab *new_slab (struct slab_cache *);
+static struct slab *obj_to_slab (struct slab_cache *, void *);
+
+/* Initializes cache C for objects of SIZE bytes, calling CTOR,
+   if it is nonnull, on each object before its first use.  Its
+   usage is printed at shutdown until it is destroyed. */
+void
+slab_cache_init (struct slab_cache *c, const char *name, size_t size,
+                 slab_ctor_func *ctor)
+{
+  enum intr_level old_level;
+  size_t obj_cnt;
+
+  ASSERT (c != NULL);
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, SLAB_ALIGN);
+
+  /* Fit as many objects as possible after the header. */
+  obj_cnt = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  while (obj_cnt > 0 && header_size (obj_cnt) + obj_cnt * c->obj_size > PGSIZE)
+    obj_cnt--;
+  ASSERT (obj_cnt > 0 && obj_cnt < SLAB_END);
+  c->obj_cnt = obj_cnt;
+  c->color_cnt = ((PGSIZE - header_size (obj_cnt) - obj_cnt * c->obj_size)
+                  / SLAB_COLOR + 1);
+  c->next_color = 0;
+  c->ctor = ctor;
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->empty);
+  c->slab_cnt = c->in_use = c->peak_in_use = 0;
+  c->allocs = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->allelem);
+  intr_set_level (old_level);
+}
+
+/* Destroys cache C, which must have no objects in use, and frees
+   its pages. */
+void
+slab_cache_destroy (struct slab_cache *c)
+{
+  enum intr_level old_level;
+
+  ASSERT (c->in_use == 0);
+  ASSERT (list_empty (&c->partial));
+
+  while (!list_empty (&c->empty))
+    {
+      struct slab *s = list_entry (list_pop_front (&c->empty),
+                                   struct slab, elem);
+      palloc_free_page (s);
+    }
+
+  old_level = intr_disable ();
+  list_remove (&c->allelem);
+  intr_set_level (old_level);
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* Find a slab with a free object. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty))
+        s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      else
+        {
+          s = new_slab (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take its first free object. */
+  ASSERT (s->free != SLAB_END);
+  obj = s->objs + s->free * c->obj_size;
+  s->free = s->next[s->free];
+  if (++s->in_use == c->obj_cnt)
+    list_remove (&s->elem);
+
+  c->allocs++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   slab_alloc(), to C.  A null OBJ is ignored. */
+void
+slab_free (struct slab_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs.  An
+     object with a constructor must keep its contents. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  s->next[idx] = s->free;
+  s->free = idx;
+  if (s->in_use-- == c->obj_cnt)
+    list_push_front (&c->partial, &s->elem);
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (list_empty (&c->empty))
+        list_push_front (&c->empty, &s->elem);
+      else
+        {
+          palloc_free_page (s);
+          c->slab_cnt--;
+        }
+    }
+  c->in_use--;
+  lock_release (&c->lock);
+}
+
+/* Prints usage statistics for each cache that has been used. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, allelem);
+      if (c->allocs == 0)
+        continue;
+      printf ("Slab: %s: %zu of %zu-byte objects in use (peak %zu), "
+              "%zu slabs of %zu, %lld allocations\n",
+              c->name, c->in_use, c->obj_size, c->peak_in_use,
+              c->slab_cnt, c->obj_cnt, c->allocs);
+    }
+}
+
+/* Returns the size of a slab header for OBJ_CNT objects. */
+static size_t
+header_size (size_t obj_cnt)
+{
+  return ROUND_UP (sizeof (struct slab) + obj_cnt * sizeof (uint16_t),
+                   SLAB_ALIGN);
+}
+
+/* Allocates a new slab for cache C, whose lock must be held, and
+   constructs its objects.  Returns a null pointer if memory is
+   not available. */
+static struct slab *
+new_slab (struct slab_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = (uint8_t *) s + header_size (c->obj_cnt)
+            + c->next_color * SLAB_COLOR;
+  c->next_color = (c->next_color + 1) % c->color_cnt;
+  s->in_use = 0;
+  s->free = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ, an object from cache C, is in. */
+static struct slab *
+obj_to_slab (struct slab_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % c->obj_size == 0);
+  ASSERT (((uint8_t *) obj - s->objs) / c->obj_size < c->obj_cnt);
+
+  return s;
+}
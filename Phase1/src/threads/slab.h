@@ -0,0 +1,48 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Object cache.
+
+   Hands out objects of a single size, packed into pages with
+   no per-object header and no rounding beyond SLAB_ALIGN, for
+   kernel structures that are allocated and freed often. */
+
+/* Called on each object when the page holding it is added to a
+   cache.  Objects handed back to slab_free() must be in the same
+   state, so that slab_alloc() can return them without calling
+   the constructor again. */
+typedef void slab_ctor_func (void *obj);
+
+/* An object cache. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded to SLAB_ALIGN. */
+    size_t obj_cnt;             /* Objects in each slab. */
+    size_t color_cnt;           /* Number of slab colors. */
+    size_t next_color;          /* Color for the next new slab. */
+    slab_ctor_func *ctor;       /* Constructor, or null. */
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with free and used objects. */
+    struct list empty;          /* Slabs with no used objects. */
+    struct list_elem allelem;   /* Element in list of all caches. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs now allocated. */
+    size_t in_use;              /* Objects now in use. */
+    size_t peak_in_use;         /* Most objects ever in use at once. */
+    long long allocs;           /* Successful slab_alloc() calls. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      slab_ctor_func *);
+void slab_cache_destroy (struct slab_cache *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -27,7 +27,24 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/io.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+
+/* Order in which threads started waiting, used to wake threads of
+   equal priority first-come, first-served. */
+static int64_t next_wait_seq;
+
+/* Locks given a name with lock_init_named(), whose contention
+   statistics are printed at shutdown. */
+static struct list named_locks = LIST_INITIALIZER (named_locks);
+
+static bool compare_waiting_threads (const struct heap_elem *,
+                                     const struct heap_elem *, void *);
+static bool compare_wait_cycles (const struct list_elem *,
+                                 const struct list_elem *, void *);
+static int donate_priority (struct lock *, int priority);
+static void donate_to_readers (struct rwlock *, int priority);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -41,7 +58,7 @@ void sema_init(struct semaphore *sema, unsigned value)
   ASSERT(sema != NULL);
 
   sema->value = value;
-  list_init(&sema->waiters);
+  heap_init(&sema->waiters, compare_waiting_threads, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -60,7 +77,10 @@ void sema_down(struct semaphore *sema)
   old_level = intr_disable();
   while (sema->value == 0)
   {
-	  list_push_back (&sema->waiters, &thread_current ()->elem);
+    struct thread *cur = thread_current ();
+    cur->waiting_sema = sema;
+    cur->wait_seq = next_wait_seq++;
+	  heap_insert (&sema->waiters, &cur->waitelem);
     thread_block();
   }
   sema->value--;
@@ -96,18 +116,27 @@ bool sema_try_down(struct semaphore *sema)
 void sema_up(struct semaphore *sema)
 {
   enum intr_level old_level;
+  bool preempt = false;
 
   ASSERT(sema != NULL);
 
   old_level = intr_disable();
-  if (!list_empty(&sema->waiters)){
-    struct thread *max_thread = list_entry(list_min(&sema->waiters,compare_threads_by_priority,NULL), struct thread, elem);
-    list_remove(&max_thread->elem);
+  if (!heap_empty(&sema->waiters)){
+    struct thread *max_thread = heap_entry(heap_pop_min(&sema->waiters), struct thread, waitelem);
+    max_thread->waiting_sema = NULL;
 	  thread_unblock (max_thread);
+    /* Only a thread that strictly ranks ahead preempts us. */
+    preempt = thread_runs_before (max_thread, thread_current ());
   }
   sema->value++;
   intr_set_level (old_level);
-  try_thread_yield ();
+  if (preempt)
+  {
+    if (intr_context ())
+      intr_yield_on_return ();
+    else
+      thread_yield ();
+  }
 }
 
 static void sema_test_helper(void *sema_);
@@ -167,6 +196,27 @@ void lock_init(struct lock *lock)
   lock->holder = NULL;
   sema_init(&lock->semaphore, 1);
   lock->max_priority=0;
+  lock->name = NULL;
+  lock->acquisitions = lock->contended = 0;
+  lock->wait_cycles = 0;
+  lock->max_chain = 0;
+}
+
+/* Initializes LOCK like lock_init() and registers it under NAME,
+   so that its contention statistics are printed at shutdown.
+   LOCK must never be freed, so this is for locks with static
+   storage duration or that live as long as the kernel does. */
+void lock_init_named(struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT(name != NULL);
+
+  lock_init(lock);
+  lock->name = name;
+  old_level = intr_disable();
+  list_push_back(&named_locks, &lock->allelem);
+  intr_set_level(old_level);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -182,43 +232,82 @@ void lock_acquire(struct lock *lock)
   ASSERT(!intr_context());
   ASSERT(!lock_held_by_current_thread(lock));
 
+  /* Fast path: an uncontended lock needs no donation, and taking
+     it cannot make a higher-priority thread ready. */
+  if (lock_try_acquire(lock))
+  {
+    lock->acquisitions++;
+    return;
+  }
+
+  uint64_t wait_start = rdtsc();
+  int chain = 0;
   if(lock->holder!=NULL){
     enum intr_level old_level = intr_disable ();
 	  thread_current ()->locked_by = lock;
-    if(!thread_mlfqs){
-      int curr_priority=thread_get_priority();
-      struct lock* temporary_lock=lock;
-      struct thread* temporary_hold=lock->holder;
-      while(temporary_lock->max_priority<curr_priority){
-        temporary_lock->max_priority=curr_priority;
-        update_thread_priority(temporary_hold);
-        if(temporary_hold->status==THREAD_READY){
-          update_ready_threads(temporary_hold);
-        }
-        temporary_lock=temporary_hold->locked_by;
-        if(temporary_lock==NULL){
-          break;
-        }else{
-          temporary_hold=temporary_lock->holder;
-        }
-        ASSERT(temporary_hold);
-      }     
-    }
+    if(!thread_mlfqs)
+      chain = donate_priority(lock, thread_get_priority());
 	  intr_set_level (old_level);
   }
   sema_down(&lock->semaphore);
+  uint64_t wait = rdtsc() - wait_start;
+  thread_account_lock_wait(wait);
   enum intr_level old_level = intr_disable ();
   thread_current()->locked_by=NULL;
   list_push_back (&thread_current ()->locks_held, &lock->elem);
   lock->holder = thread_current();
   intr_set_level (old_level);
+
+  /* Only the holder updates the statistics, so they need no
+     further locking. */
+  lock->acquisitions++;
+  lock->contended++;
+  lock->wait_cycles += wait;
+  if (chain > lock->max_chain)
+    lock->max_chain = chain;
   if(!thread_mlfqs){
     update_lock_priority(lock);
     update_thread_priority(thread_current());
-    thread_yield();
-
   }
+}
 
+/* Donates PRIORITY to the holder of LOCK, and on down the chain
+   of locks the holders are themselves waiting for, wherever it is
+   higher than what they already have.  Returns the number of
+   locks along the chain that took the donation.  Interrupts must
+   be off. */
+static int
+donate_priority(struct lock *lock, int priority)
+{
+  struct lock* temporary_lock=lock;
+  struct thread* temporary_hold=lock->holder;
+  int depth = 0;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if(temporary_hold==NULL)
+    return 0;
+  while(temporary_lock->max_priority<priority){
+    depth++;
+    temporary_lock->max_priority=priority;
+    trace_event(TRACE_DONATE, temporary_hold, thread_current(), priority);
+    update_thread_priority(temporary_hold);
+    if(temporary_hold->status==THREAD_READY){
+      update_ready_threads(temporary_hold);
+    }
+    temporary_lock=temporary_hold->locked_by;
+    if(temporary_lock==NULL){
+      /* A writer waiting out an rwlock's readers passes the
+         donation on to all of them. */
+      if (temporary_hold->waiting_rwlock != NULL)
+        donate_to_readers(temporary_hold->waiting_rwlock, priority);
+      break;
+    }else{
+      temporary_hold=temporary_lock->holder;
+    }
+    ASSERT(temporary_hold);
+  }
+  return depth;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -235,7 +324,14 @@ bool lock_try_acquire(struct lock *lock)
 
   success = sema_try_down(&lock->semaphore);
   if (success)
+  {
+    enum intr_level old_level = intr_disable ();
+    list_push_back (&thread_current ()->locks_held, &lock->elem);
     lock->holder = thread_current();
+    intr_set_level (old_level);
+    if(!thread_mlfqs)
+      update_lock_priority(lock);
+  }
   return success;
 }
 
@@ -248,6 +344,7 @@ void lock_release(struct lock *lock)
   ASSERT(lock != NULL);
   ASSERT(lock_held_by_current_thread(lock));
 
+  int old_priority = thread_get_priority();
   enum intr_level old_level = intr_disable ();
   list_remove (&lock->elem);
   intr_set_level (old_level);
@@ -257,6 +354,10 @@ void lock_release(struct lock *lock)
   }
   lock->holder = NULL;
   sema_up(&lock->semaphore);
+  /* Losing a donation may leave a ready thread above us even if the
+     thread sema_up() woke is not. */
+  if (thread_get_priority() < old_priority)
+    try_thread_yield();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -270,7 +371,7 @@ bool lock_held_by_current_thread(const struct lock *lock)
 }
 
 void update_lock_priority(struct lock* lock){
-  if(list_empty (&(&lock->semaphore)->waiters)|| lock->holder!=NULL){
+  if(heap_empty (&(&lock->semaphore)->waiters)|| lock->holder!=NULL){
     if(lock->holder!=NULL){
       lock->max_priority= lock->holder->priority;
     }else{
@@ -292,12 +393,175 @@ bool compare_locks_by_priority (const struct list_elem *a,
 }
 
 
-/* One semaphore in a list. */
+/* Initializes RW as an rwlock that nobody holds. */
+void rwlock_init(struct rwlock *rw)
+{
+  ASSERT(rw != NULL);
+
+  lock_init(&rw->lock);
+  list_init(&rw->readers);
+  rw->drainer = NULL;
+  sema_init(&rw->drained, 0);
+  rw->max_priority = PRI_MIN;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+   is waiting for it ahead of us.  The current thread must not
+   already hold RW, and may hold at most RWLOCK_READ_MAX rwlocks
+   for reading at once.
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_read_acquire(struct rwlock *rw)
+{
+  struct thread *cur = thread_current();
+  struct rwlock_hold *hold = NULL;
+  enum intr_level old_level;
+  int i;
+
+  ASSERT(rw != NULL);
+  ASSERT(!intr_context());
+  ASSERT(!lock_held_by_current_thread(&rw->lock));
+
+  for (i = 0; i < RWLOCK_READ_MAX; i++)
+  {
+    ASSERT(cur->rw_holds[i].rwlock != rw);
+    if (hold == NULL && cur->rw_holds[i].rwlock == NULL)
+      hold = &cur->rw_holds[i];
+  }
+  ASSERT(hold != NULL);
+
+  /* Passing through LOCK puts us behind any writer that holds RW
+     or is waiting for its readers to leave. */
+  lock_acquire(&rw->lock);
+  old_level = intr_disable();
+  hold->rwlock = rw;
+  hold->thread = cur;
+  list_push_back(&rw->readers, &hold->elem);
+  intr_set_level(old_level);
+  lock_release(&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading,
+   giving up any priority that a waiting writer donated. */
+void rwlock_read_release(struct rwlock *rw)
+{
+  struct thread *cur = thread_current();
+  struct rwlock_hold *hold = NULL;
+  enum intr_level old_level;
+  bool drained;
+  int i;
+
+  ASSERT(rw != NULL);
+
+  for (i = 0; i < RWLOCK_READ_MAX; i++)
+    if (cur->rw_holds[i].rwlock == rw)
+      hold = &cur->rw_holds[i];
+  ASSERT(hold != NULL);
+
+  old_level = intr_disable();
+  list_remove(&hold->elem);
+  hold->rwlock = NULL;
+  drained = list_empty(&rw->readers) && rw->drainer != NULL;
+  if (!thread_mlfqs)
+    update_thread_priority(cur);
+  intr_set_level(old_level);
+
+  if (drained)
+    sema_up(&rw->drained);
+  try_thread_yield();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_write_acquire(struct rwlock *rw)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(rw != NULL);
+  ASSERT(!intr_context());
+
+  lock_acquire(&rw->lock);
+  old_level = intr_disable();
+  if (!list_empty(&rw->readers))
+  {
+    rw->drainer = cur;
+    cur->waiting_rwlock = rw;
+    if (!thread_mlfqs)
+      donate_to_readers(rw, thread_get_priority());
+    intr_set_level(old_level);
+
+    sema_down(&rw->drained);
+
+    old_level = intr_disable();
+    cur->waiting_rwlock = NULL;
+    rw->drainer = NULL;
+    rw->max_priority = PRI_MIN;
+  }
+  intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void rwlock_write_release(struct rwlock *rw)
+{
+  ASSERT(rw != NULL);
+
+  lock_release(&rw->lock);
+}
+
+/* Returns the highest priority donated to thread T by writers
+   waiting for rwlocks that T holds for reading, or PRI_MIN if
+   there is none. */
+int rwlock_donated_priority(const struct thread *t)
+{
+  int priority = PRI_MIN;
+  int i;
+
+  for (i = 0; i < RWLOCK_READ_MAX; i++)
+  {
+    const struct rwlock *rw = t->rw_holds[i].rwlock;
+    if (rw != NULL && rw->max_priority > priority)
+      priority = rw->max_priority;
+  }
+  return priority;
+}
+
+/* Donates PRIORITY to every thread reading RW, on behalf of the
+   writer waiting for them to leave, and on down the chains of
+   locks those readers are waiting for.  Interrupts must be off. */
+static void
+donate_to_readers(struct rwlock *rw, int priority)
+{
+  struct list_elem *e;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (rw->max_priority >= priority)
+    return;
+  rw->max_priority = priority;
+  for (e = list_begin(&rw->readers); e != list_end(&rw->readers);
+       e = list_next(e))
+  {
+    struct thread *t = list_entry(e, struct rwlock_hold, elem)->thread;
+
+    trace_event(TRACE_DONATE, t, thread_current(), priority);
+    update_thread_priority(t);
+    if (t->status == THREAD_READY)
+      update_ready_threads(t);
+    if (t->locked_by != NULL)
+      donate_priority(t->locked_by, priority);
+  }
+}
+
+/* One semaphore in a condition variable's waiters. */
 struct semaphore_elem
 {
-  struct list_elem elem;      /* List element. */
+  struct heap_elem elem;      /* Heap element. */
   struct semaphore semaphore; /* This semaphore. */
-  int priority;               // the max priority of the waiting threads on the semaphore
+  struct thread *thread;      // the thread waiting on the semaphore
+  int64_t wait_seq;           // when the thread started waiting on the condition
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -307,7 +571,7 @@ void cond_init(struct condition *cond)
 {
   ASSERT(cond != NULL);
 
-  list_init(&cond->waiters);
+  heap_init(&cond->waiters, compare_semaphore_priority, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -337,35 +601,95 @@ void cond_wait(struct condition *cond, struct lock *lock)
   ASSERT(lock_held_by_current_thread(lock));
 
   sema_init(&waiter.semaphore, 0);
-  waiter.priority = thread_get_priority ();
-  list_insert_ordered (&cond->waiters, &waiter.elem,compare_semaphore_priority, NULL);
+  waiter.thread = thread_current ();
+  enum intr_level old_level = intr_disable ();
+  waiter.wait_seq = next_wait_seq++;
+  waiter.thread->waiting_cond = cond;
+  waiter.thread->cond_waiter = &waiter.elem;
+  heap_insert (&cond->waiters, &waiter.elem);
+  intr_set_level (old_level);
   lock_release(lock);
   sema_down(&waiter.semaphore);
+
+  /* If we were moved onto LOCK's waiters, we were woken by its
+     release and it is most likely free now. */
+  old_level = intr_disable ();
+  thread_current ()->locked_by = NULL;
+  intr_set_level (old_level);
   lock_acquire(lock);
 }
 
-bool compare_semaphore_priority (const struct list_elem *a,const struct list_elem *b,void *aux UNUSED)
+//orders condition variable waiters by the current priority of the waiting thread
+bool compare_semaphore_priority (const struct heap_elem *a,const struct heap_elem *b,void *aux UNUSED)
 {
-  return list_entry (a, struct semaphore_elem, elem)->priority >
-         list_entry (b, struct semaphore_elem, elem)->priority;
+  const struct semaphore_elem *waiter_a = heap_entry (a, struct semaphore_elem, elem);
+  const struct semaphore_elem *waiter_b = heap_entry (b, struct semaphore_elem, elem);
+  if (thread_runs_before (waiter_a->thread, waiter_b->thread))
+    return true;
+  if (thread_runs_before (waiter_b->thread, waiter_a->thread))
+    return false;
+  return waiter_a->wait_seq < waiter_b->wait_seq;
 }
 
 
+/* Hands the highest-priority waiter on COND over to LOCK, which
+   the caller holds, and returns true, or returns false if COND has
+   no waiters.
+
+   Waking the waiter now would only have it run and block again in
+   lock_acquire(), so if it is already asleep it is moved straight
+   onto LOCK's waiters instead, donating its priority as if it had
+   called lock_acquire() itself ("wait morphing").  Its own
+   semaphore is posted so that its sema_down() returns once the
+   lock release wakes it.  A waiter that has not gone to sleep yet
+   is simply woken.  Interrupts must be off. */
+static bool
+cond_transfer_waiter(struct condition *cond, struct lock *lock)
+{
+  struct semaphore_elem *waiter;
+  struct thread *t;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (heap_empty(&cond->waiters))
+    return false;
+
+  waiter = heap_entry(heap_pop_min(&cond->waiters),struct semaphore_elem, elem);
+  t = waiter->thread;
+  t->waiting_cond = NULL;
+  if (t->waiting_sema != &waiter->semaphore)
+  {
+    sema_up(&waiter->semaphore);
+    return true;
+  }
+
+  heap_remove(&waiter->semaphore.waiters, &t->waitelem);
+  waiter->semaphore.value++;
+  t->waiting_sema = &lock->semaphore;
+  t->wait_seq = next_wait_seq++;
+  heap_insert(&lock->semaphore.waiters, &t->waitelem);
+  t->locked_by = lock;
+  if(!thread_mlfqs)
+    donate_priority(lock, t->priority);
+  return true;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
    interrupt handler. */
-void cond_signal(struct condition *cond, struct lock *lock UNUSED)
+void cond_signal(struct condition *cond, struct lock *lock)
 {
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  if (!list_empty(&cond->waiters))
-    sema_up(&list_entry(list_pop_front(&cond->waiters),struct semaphore_elem, elem)->semaphore);
+  enum intr_level old_level = intr_disable ();
+  cond_transfer_waiter(cond, lock);
+  intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -378,12 +702,88 @@ void cond_broadcast(struct condition *cond, struct lock *lock)
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
 
-  while (!list_empty(&cond->waiters))
-    cond_signal(cond, lock);
+  ASSERT(!intr_context());
+  ASSERT(lock_held_by_current_thread(lock));
+
+  enum intr_level old_level = intr_disable ();
+  while (cond_transfer_waiter(cond, lock))
+    continue;
+  intr_set_level (old_level);
 }
 
 struct thread * get_max_thread(struct semaphore *sema)
 {
-  ASSERT (!list_empty (&sema->waiters));
-  return list_entry (list_min (&sema->waiters,compare_threads_by_priority, NULL),struct thread, elem);
+  ASSERT (!heap_empty (&sema->waiters));
+  return heap_entry (heap_min (&sema->waiters),struct thread, waitelem);
+}
+
+/* Re-sorts T, whose priority has just changed, among the waiters
+   of the semaphore and the condition variable it is waiting on,
+   if any.  Interrupts must be off. */
+void update_waiting_thread (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->waiting_sema != NULL)
+  {
+    heap_remove (&t->waiting_sema->waiters, &t->waitelem);
+    heap_insert (&t->waiting_sema->waiters, &t->waitelem);
+  }
+  if (t->waiting_cond != NULL)
+  {
+    heap_remove (&t->waiting_cond->waiters, t->cond_waiter);
+    heap_insert (&t->waiting_cond->waiters, t->cond_waiter);
+  }
+}
+
+/* Orders semaphore waiters as the scheduler would, then by
+   arrival. */
+static bool
+compare_waiting_threads (const struct heap_elem *a,
+                         const struct heap_elem *b,
+                         void *aux UNUSED)
+{
+  const struct thread *thread_a = heap_entry (a, struct thread, waitelem);
+  const struct thread *thread_b = heap_entry (b, struct thread, waitelem);
+  if (thread_runs_before (thread_a, thread_b))
+    return true;
+  if (thread_runs_before (thread_b, thread_a))
+    return false;
+  return thread_a->wait_seq < thread_b->wait_seq;
+}
+
+/* Orders locks by total time spent waiting for them, longest
+   first. */
+static bool
+compare_wait_cycles (const struct list_elem *a_, const struct list_elem *b_,
+                     void *aux UNUSED)
+{
+  const struct lock *a = list_entry (a_, struct lock, allelem);
+  const struct lock *b = list_entry (b_, struct lock, allelem);
+  return a->wait_cycles > b->wait_cycles;
+}
+
+/* Prints contention statistics for the named locks that have
+   been acquired, those waited on longest first. */
+void
+lock_print_stats (void)
+{
+  struct list_elem *e;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  list_sort (&named_locks, compare_wait_cycles, NULL);
+  intr_set_level (old_level);
+
+  for (e = list_begin (&named_locks); e != list_end (&named_locks);
+       e = list_next (e))
+    {
+      struct lock *l = list_entry (e, struct lock, allelem);
+      if (l->acquisitions == 0)
+        continue;
+      printf ("Lock: %s: %lld acquisitions, %lld contended, "
+              "%llu cycles waiting, donation chain %d\n",
+              l->name, l->acquisitions, l->contended,
+              (unsigned long long) l->wait_cycles, l->max_chain);
+    }
 }
@@ -1,14 +1,18 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore
 {
   unsigned value;      /* Current value. */
-  struct list waiters; /* List of waiting threads. */
+  struct heap waiters; /* Waiting threads, highest priority first. */
 };
 
 void sema_init(struct semaphore *, unsigned value);
@@ -26,18 +30,70 @@ struct lock
   struct list_elem elem;    // pointer for a lock in a list
   int max_priority;         // the max priority of all threads waiting for the lock
   /*-----------------------------------------------------------------------*/
+
+  /* Contention statistics, updated by the holder. */
+  const char *name;           /* Name, or null if not profiled. */
+  struct list_elem allelem;   /* Element in list of named locks. */
+  long long acquisitions;     /* # of times acquired. */
+  long long contended;        /* # of times a thread had to wait. */
+  uint64_t wait_cycles;       /* Total TSC cycles spent waiting. */
+  int max_chain;              /* Longest donation chain walked. */
 };
 
 void lock_init(struct lock *);
+void lock_init_named(struct lock *, const char *name);
+void lock_print_stats(void);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_held_by_current_thread(const struct lock *);
 void update_lock_priority(struct lock* lock);
+
+/* Reader-writer lock.
+
+   Any number of readers may hold it at once, or one writer.  A
+   writer first takes LOCK, which keeps new readers out, and then
+   waits for the readers already inside to leave, so readers
+   cannot starve writers.  Readers take LOCK only for a moment on
+   the way in, so readers and writers are let in the order LOCK
+   wakes them: by priority, then first-come, first-served.
+
+   Threads waiting for LOCK donate their priority to its holder
+   as usual.  A writer waiting for readers to leave donates its
+   priority to all of them, and that donation is passed on along
+   the lock chains the readers are themselves waiting on. */
+struct rwlock
+{
+  struct lock lock;           /* Held by a writer, or by a reader entering. */
+  struct list readers;        /* Read holds on this rwlock. */
+  struct thread *drainer;     /* Writer waiting for READERS to leave. */
+  struct semaphore drained;   /* Upped when the last reader leaves. */
+  int max_priority;           /* Priority donated to readers. */
+};
+
+/* A thread's hold on an rwlock for reading. */
+struct rwlock_hold
+{
+  struct rwlock *rwlock;      /* Held rwlock, or null if slot is free. */
+  struct thread *thread;      /* Holding thread. */
+  struct list_elem elem;      /* Element in RWLOCK's readers. */
+};
+
+/* Maximum number of rwlocks one thread can hold for reading at
+   once. */
+#define RWLOCK_READ_MAX 4
+
+void rwlock_init(struct rwlock *);
+void rwlock_read_acquire(struct rwlock *);
+void rwlock_read_release(struct rwlock *);
+void rwlock_write_acquire(struct rwlock *);
+void rwlock_write_release(struct rwlock *);
+int rwlock_donated_priority(const struct thread *);
+
 /* Condition variable. */
 struct condition
 {
-  struct list waiters; /* List of waiting threads. */
+  struct heap waiters; /* Waiting threads, highest priority first. */
 };
 
 void cond_init(struct condition *);
@@ -55,7 +111,8 @@ void cond_broadcast(struct condition *, struct lock *);
                                : "memory")
 
 struct thread * get_max_thread (struct semaphore *);
+void update_waiting_thread (struct thread *);
 bool compare_locks_by_priority(const struct list_elem *, const struct list_elem *, void *);
-bool compare_semaphore_priority (const struct list_elem *,const struct list_elem *,void *);
+bool compare_semaphore_priority (const struct heap_elem *,const struct heap_elem *,void *);
 #endif /* threads/synch.h */
 
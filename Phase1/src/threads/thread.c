@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <histogram.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -7,11 +8,14 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/io.h"
 #include "threads/palloc.h"
+#include "threads/trace.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/fixed_point.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -21,20 +25,52 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO list per priority.  Bit (PRI_MAX - P) of
+   `bitmap' is set iff queues[P] is nonempty, so the
+   highest-priority ready thread is found with a single bit scan.
+   Threads in the real-time class are kept apart, ordered by
+   deadline, and all run before any thread in QUEUES. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+struct runqueue
+{
+  struct heap edf;             /* Real-time threads, by deadline. */
+  struct list queues[PRI_CNT]; /* One FIFO list per priority. */
+  uint64_t bitmap;             /* Nonempty members of QUEUES. */
+  int cnt;                     /* # of threads in the run queue. */
+};
+
+static struct runqueue ready_queue;
+
+/* Idle thread. */
+static struct thread *idle_thread;
+
+/* Up to THREAD_CACHE_MAX pages of dead threads are kept for new
+   threads to reuse, and the idle thread tops the cache up to
+   THREAD_CACHE_LOW pages.  Only touched with interrupts off. */
+#define THREAD_CACHE_MAX 16
+#define THREAD_CACHE_LOW 4
+static void *page_cache[THREAD_CACHE_MAX];
+static int page_cache_cnt;
+
+/* Admission control for the earliest-deadline-first real-time
+   class.  Each real-time thread claims RUNTIME / min(DEADLINE,
+   PERIOD) of the CPU, in millionths, and together they may claim
+   at most EDF_MAX_UTIL, which keeps their deadlines feasible and
+   leaves the rest of the CPU to other threads. */
+#define EDF_MAX_UTIL 900000
+static int64_t edf_util;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* List of sleeping processes. When the TIMER SLEEP is called,
-   put the current process into this list. */
-static struct list sleeping_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Sleeping processes, ordered by the absolute timer tick at
+   which they should wake up.  When TIMER SLEEP is called, the
+   current process is inserted here, and thread_tick() wakes
+   processes off the front as their wake tick passes. */
+static struct heap sleeping_threads;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -54,10 +90,15 @@ struct kernel_thread_frame
 static long long idle_ticks;   /* # of timer ticks spent idle. */
 static long long kernel_ticks; /* # of timer ticks in kernel threads. */
 static long long user_ticks;   /* # of timer ticks in user programs. */
+static long long context_switches; /* # of switches between threads. */
+static unsigned thread_ticks;  /* # of timer ticks since last yield. */
+static struct thread_acct exited_acct; /* Sum over threads that exited. */
+static struct histogram ready_latency; /* Cycles from ready to running. */
+static struct histogram lock_latency;  /* Cycles spent acquiring locks. */
 
-/* Scheduling. */
-#define TIME_SLICE 4          /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
+/* Scheduling.  # of timer ticks to give each thread, set by
+   kernel command-line option "-slice". */
+int thread_time_slice = TIME_SLICE_DEFAULT;
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -80,6 +121,21 @@ static void schedule(void);
 void thread_schedule_tail(struct thread *prev);
 static tid_t allocate_tid(void);
 
+static bool is_idle_thread(struct thread *);
+static void runqueue_init(struct runqueue *);
+static void runqueue_push(struct runqueue *, struct thread *);
+static void runqueue_requeue(struct runqueue *, struct thread *);
+static struct thread *runqueue_pop(struct runqueue *);
+static struct thread *thread_page_get(void);
+static void thread_page_put(struct thread *);
+static void thread_cache_refill(void);
+static void add_acct(struct thread_acct *, const struct thread_acct *);
+static struct thread *runqueue_first(struct runqueue *);
+static bool runqueue_preempts(struct runqueue *, struct thread *);
+static bool compare_deadlines(const struct heap_elem *, const struct heap_elem *, void *);
+static int64_t edf_density(int64_t runtime, int64_t period, int64_t deadline);
+static void edf_new_period(struct thread *, int64_t now);
+
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
@@ -94,10 +150,10 @@ void thread_init(void)
 {
   ASSERT(intr_get_level() == INTR_OFF);
 
-  lock_init(&tid_lock);
-  list_init(&ready_list);
+  lock_init_named(&tid_lock, "tid");
+  runqueue_init(&ready_queue);
   list_init(&all_list);
-  list_init(&sleeping_list);
+  heap_init(&sleeping_threads, compare_threads_by_wake_tick, NULL);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread();
@@ -132,13 +188,13 @@ bool compare_threads_by_priority(const struct list_elem *a,
   return thread_a->priority > thread_b->priority;
 }
 
-bool compare_threads_by_priority_sleeping(const struct list_elem *a,
-                                          const struct list_elem *b,
-                                          void *aux UNUSED)
+bool compare_threads_by_wake_tick(const struct heap_elem *a,
+                                  const struct heap_elem *b,
+                                  void *aux UNUSED)
 {
-  struct thread *thread_a = list_entry(a, struct thread, sleepingelem);
-  struct thread *thread_b = list_entry(b, struct thread, sleepingelem);
-  return thread_a->priority > thread_b->priority;
+  struct thread *thread_a = heap_entry(a, struct thread, sleepingelem);
+  struct thread *thread_b = heap_entry(b, struct thread, sleepingelem);
+  return thread_a->wake_tick < thread_b->wake_tick;
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -148,7 +204,7 @@ void thread_tick(void)
   struct thread *t = thread_current();
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (is_idle_thread(t))
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -156,51 +212,76 @@ void thread_tick(void)
 #endif
   else
     kernel_ticks++;
+  if (!is_idle_thread(t))
+    t->acct.run_ticks++;
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
-    intr_yield_on_return();
+  /* Charge a real-time thread for the tick, and once its budget
+     for the period is gone, make it wait for the next period. */
+  if (t->dl_runtime != 0 && --t->dl_budget <= 0)
+  {
+    t->dl_throttled = true;
+    if (intr_context())
+      intr_yield_on_return();
+  }
 
-  /* Iterate through all sleeping threads in SLEEPING LIST, decrease the
-  REMAINING TIME TO WAKE UP of these threads by 1. If any of them have a
-  zero REMAINING TIME TO WAKE UP, wake up these threads. */
-  struct list_elem *e = list_begin(&sleeping_list);
-  struct list_elem *temp;
+  /* Enforce preemption.  Ticks that the idle thread replays after
+     a tickless idle period run outside interrupt context, and the
+     idle thread has nobody to yield to anyway. */
+  if (++thread_ticks >= (unsigned) thread_time_slice && intr_context())
+    intr_yield_on_return();
 
-  while (e != list_end(&sleeping_list))
+  /* Wake up every sleeping thread whose WAKE TICK has passed.  The
+     earliest one is always at the top of SLEEPING THREADS, so when
+     nothing is due this is a single comparison. */
+  int64_t now = timer_ticks();
+  while (!heap_empty(&sleeping_threads))
   {
-    struct thread *t = list_entry(e, struct thread, sleepingelem);
-    temp = e;
-    e = list_next(e);
+    struct thread *t = heap_entry(heap_min(&sleeping_threads), struct thread, sleepingelem);
+    if (t->wake_tick > now)
+      break;
 
     ASSERT(t->status == THREAD_BLOCKED);
-
-    if (t->remaining_time_to_wake_up > 0)
-    {
-      t->remaining_time_to_wake_up--;
-      if (t->remaining_time_to_wake_up <= 0)
-      {
-        thread_unblock(t);
-        list_remove(temp);
-      }
-    }
+    heap_pop_min(&sleeping_threads);
+    trace_event(TRACE_WAKEUP, t, NULL, now - t->wake_tick);
+    thread_unblock(t);
   }
+
+  /* A thread that woke up, or a real-time thread whose new
+     period began, may have to run right away. */
+  if (intr_context() && !is_idle_thread(t)
+      && runqueue_preempts(&ready_queue, t))
+    intr_yield_on_return();
 }
 
-void sleep_thread(int64_t ticks)
+/* Returns the earliest timer tick at which a sleeping thread
+   must be woken, or INT64_MAX if no thread is sleeping.
+   This function must be called with interrupts turned off. */
+int64_t thread_next_wake_tick(void)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (heap_empty(&sleeping_threads))
+    return INT64_MAX;
+  return heap_entry(heap_min(&sleeping_threads), struct thread, sleepingelem)->wake_tick;
+}
+
+/* Blocks the current thread until timer tick WAKE_TICK.
+   This function must be called with interrupts turned off. */
+void sleep_thread(int64_t wake_tick)
 {
   struct thread *cur = thread_current();
-  cur->remaining_time_to_wake_up = ticks;
-  enum intr_level old_level = intr_disable();
-  list_insert_ordered(&sleeping_list, &cur->sleepingelem, compare_threads_by_priority_sleeping, NULL);  
-  intr_set_level(old_level);
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  cur->wake_tick = wake_tick;
+  heap_insert(&sleeping_threads, &cur->sleepingelem);
   thread_block();
 }
 
 void try_thread_yield(void)
 {
   enum intr_level old_level = intr_disable();
-  bool result = !list_empty(&ready_list) && (list_entry(list_min(&ready_list,compare_threads_by_priority,NULL), struct thread, elem)->priority > thread_get_priority());
+  bool result = runqueue_preempts(&ready_queue, thread_current());
   intr_set_level(old_level);
   // msg("hena %d",result);
   if (result){
@@ -210,11 +291,38 @@ void try_thread_yield(void)
 
 /*---------------------------------------------------------------------------------------*/
 
+/* Prints the CPU accounting of thread T, for
+   thread_print_stats(). */
+static void
+print_acct(struct thread *t, void *aux UNUSED)
+{
+  const struct thread_acct *a = t != NULL ? &t->acct : &exited_acct;
+
+  if (t != NULL)
+    printf("Thread: %d %s: ", t->tid, t->name);
+  else
+    printf("Thread: exited threads: ");
+  printf("%lld ticks running, %lld voluntary and %lld involuntary switches, "
+         "%llu cycles ready, %llu cycles waiting for locks\n",
+         a->run_ticks, a->voluntary_switches, a->involuntary_switches,
+         a->ready_cycles, a->lock_wait_cycles);
+}
+
 /* Prints thread statistics. */
 void thread_print_stats(void)
 {
+  enum intr_level old_level;
+
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
          idle_ticks, kernel_ticks, user_ticks);
+  printf("Thread: %lld context switches\n", context_switches);
+
+  old_level = intr_disable();
+  thread_foreach(print_acct, NULL);
+  print_acct(NULL, NULL);
+  intr_set_level(old_level);
+  histogram_print(&ready_latency, "Thread: ", "cycles ready before running");
+  histogram_print(&lock_latency, "Thread: ", "cycles waiting for locks");
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -242,7 +350,7 @@ tid_t thread_create(const char *name, int priority,
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = thread_page_get();
   if (t == NULL)
     return TID_ERROR;
 
@@ -282,6 +390,7 @@ void thread_block(void)
   ASSERT(intr_get_level() == INTR_OFF);
 
   thread_current()->status = THREAD_BLOCKED;
+  trace_event(TRACE_BLOCK, thread_current(), NULL, thread_current()->priority);
   schedule();
 }
 
@@ -299,8 +408,17 @@ void thread_unblock(struct thread *t)
   ASSERT(is_thread(t));
   old_level = intr_disable();
   ASSERT(t->status == THREAD_BLOCKED);
-  list_push_back(&ready_list, &t->elem);
+  if (t->dl_runtime != 0)
+  {
+    /* A real-time thread that sat out the rest of a period, or
+       that wakes up after its deadline, starts a new period. */
+    int64_t now = timer_ticks();
+    if (t->dl_throttled || now >= t->dl_abs_deadline)
+      edf_new_period(t, now);
+  }
   t->status = THREAD_READY;
+  runqueue_push(&ready_queue, t);
+  trace_event(TRACE_UNBLOCK, t, running_thread(), t->priority);
   intr_set_level(old_level);
 
 }
@@ -346,12 +464,18 @@ void thread_exit(void)
 #ifdef USERPROG
   process_exit();
 #endif
+  malloc_thread_exit();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable();
   list_remove(&thread_current()->allelem);
+  add_acct(&exited_acct, &thread_current()->acct);
+  if (thread_current()->dl_runtime != 0)
+    edf_util -= edf_density(thread_current()->dl_runtime,
+                            thread_current()->dl_period,
+                            thread_current()->dl_deadline);
   thread_current()->status = THREAD_DYING;
   schedule();
   NOT_REACHED();
@@ -367,15 +491,137 @@ void thread_yield(void)
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  if (cur != idle_thread)
+  if (cur->dl_throttled)
   {
-    list_push_back(&ready_list, &cur->elem);
+    /* A real-time thread out of budget sits out the rest of its
+       period, unless that has already passed. */
+    int64_t now = timer_ticks();
+    int64_t next_period = cur->dl_period_start + cur->dl_period;
+    if (next_period > now)
+    {
+      sleep_thread(next_period);
+      intr_set_level(old_level);
+      return;
+    }
+    edf_new_period(cur, now);
   }
   cur->status = THREAD_READY;
+  if (!is_idle_thread(cur))
+  {
+    runqueue_push(&ready_queue, cur);
+  }
+  else
+  {
+    /* An interrupt woke the idle thread from a tickless halt and
+       is handing the CPU to the thread it woke, so the periodic
+       timer has to be running again first. */
+    timer_idle_exit();
+  }
   schedule();
   intr_set_level(old_level);
 }
 
+/* Records that the running thread spent CYCLES acquiring a
+   lock. */
+void thread_account_lock_wait(uint64_t cycles)
+{
+  enum intr_level old_level = intr_disable();
+  thread_current()->acct.lock_wait_cycles += cycles;
+  histogram_add(&lock_latency, cycles);
+  intr_set_level(old_level);
+}
+
+/* Puts the running thread in the earliest-deadline-first
+   real-time class.  Each PERIOD timer ticks, starting now, it
+   may run for up to RUNTIME ticks, which must be finished
+   DEADLINE ticks into the period.  While it has budget left, it
+   runs ahead of all threads outside the class, and ahead of the
+   threads in the class with later deadlines.  A thread that
+   runs out of budget waits for its next period.
+
+   Returns false, leaving the thread as it was, if RUNTIME <=
+   DEADLINE <= PERIOD does not hold or if admitting the thread
+   would let the class claim more than EDF_MAX_UTIL of the CPU.
+   A RUNTIME of 0 takes the thread out of the class. */
+bool thread_set_deadline(int64_t runtime, int64_t period, int64_t deadline)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+  int64_t old_density = 0;
+  int64_t new_density = 0;
+
+  if (runtime < 0 || (runtime > 0 && (runtime > deadline || deadline > period)))
+    return false;
+
+  old_level = intr_disable();
+  if (cur->dl_runtime != 0)
+    old_density = edf_density(cur->dl_runtime, cur->dl_period, cur->dl_deadline);
+  if (runtime != 0)
+    new_density = edf_density(runtime, period, deadline);
+  if (edf_util - old_density + new_density > EDF_MAX_UTIL)
+  {
+    intr_set_level(old_level);
+    return false;
+  }
+  edf_util += new_density - old_density;
+
+  cur->dl_runtime = runtime;
+  cur->dl_period = period;
+  cur->dl_deadline = deadline;
+  cur->dl_misses = 0;
+  if (runtime != 0)
+    edf_new_period(cur, timer_ticks());
+  else
+    cur->dl_throttled = false;
+  intr_set_level(old_level);
+
+  /* Leaving the class may let some other thread go first. */
+  try_thread_yield();
+  return true;
+}
+
+/* Called by a real-time thread when it has finished its work for
+   the current period.  Counts a deadline miss if it is late, and
+   then waits for the next period to begin. */
+void thread_deadline_yield(void)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+  int64_t now, next_period;
+
+  ASSERT(cur->dl_runtime != 0);
+
+  old_level = intr_disable();
+  now = timer_ticks();
+  if (now > cur->dl_abs_deadline)
+    cur->dl_misses++;
+  next_period = cur->dl_period_start + cur->dl_period;
+  if (next_period > now)
+    sleep_thread(next_period);
+  else
+    edf_new_period(cur, now);
+  intr_set_level(old_level);
+}
+
+/* Returns the number of periods in which the running real-time
+   thread finished its work after its deadline. */
+int thread_get_deadline_misses(void)
+{
+  return thread_current()->dl_misses;
+}
+
+/* Returns true if thread A should run before thread B: real-time
+   threads before all others, earliest deadline first, and other
+   threads in order of priority. */
+bool thread_runs_before(const struct thread *a, const struct thread *b)
+{
+  if ((a->dl_runtime != 0) != (b->dl_runtime != 0))
+    return a->dl_runtime != 0;
+  if (a->dl_runtime != 0)
+    return a->dl_abs_deadline < b->dl_abs_deadline;
+  return a->priority > b->priority;
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void thread_foreach(thread_action_func *func, void *aux)
@@ -411,10 +657,11 @@ void update_thread_priority (struct thread *t)
 {
   enum intr_level old_level = intr_disable ();
   int real_priority = t->real_priority;
+  int old_priority = t->priority;
+  int rwlock_priority = rwlock_donated_priority (t);
   
-  if (list_empty (&t->locks_held))
-    t->priority = real_priority;
-  else
+  t->priority = real_priority;
+  if (!list_empty (&t->locks_held))
     {
 	  int lock_priority = list_entry (list_max(&t->locks_held,compare_locks_by_priority, NULL),struct lock, elem)->max_priority;	 
      /* If the waiting threads in the lock has a higher priority than the    
@@ -424,17 +671,21 @@ void update_thread_priority (struct thread *t)
       }
       
 	} 
+  /* So do writers waiting for rwlocks that it is reading. */
+  if (t->priority < rwlock_priority)
+    t->priority = rwlock_priority;
+  if (t->priority != old_priority)
+    update_waiting_thread (t);
   intr_set_level (old_level);
 }
 
+//moves a ready thread to the run queue matching its (possibly changed) priority
 void update_ready_threads(struct thread* t){
   ASSERT (t->status == THREAD_READY);
   enum intr_level old_level = intr_disable ();
-  list_remove (&t->elem);
-  list_insert_ordered (&ready_list, &t->elem,compare_threads_by_priority, NULL);
+  if (t->queued_priority != t->priority)
+    runqueue_requeue (&ready_queue, t);
   intr_set_level (old_level);
-
-
 }
 
 
@@ -499,10 +750,21 @@ idle(void *idle_started_ UNUSED)
 
   for (;;)
   {
+    /* Zero free pages while there is nothing else to do.  This
+       runs with interrupts on, so any thread woken meanwhile
+       preempts it. */
+    palloc_zero_refill();
+
     /* Let someone else run. */
     intr_disable();
+    timer_idle_exit();
+    thread_cache_refill();
     thread_block();
 
+    /* Nothing is ready to run, so in tickless mode stop the
+       periodic timer until the next sleeping thread is due. */
+    timer_idle_enter();
+
     /* Re-enable interrupts and wait for the next one.
        The `sti' instruction disables interrupts until the
        completion of the next instruction, so these two
@@ -570,7 +832,7 @@ init_thread(struct thread *t, const char *name, int priority)
   t->stack = (uint8_t *)t + PGSIZE;
   t->priority = priority;
   t->magic = THREAD_MAGIC;
-  t->remaining_time_to_wake_up = 0;
+  t->wake_tick = 0;
   t->real_priority = priority;
   t->locked_by = NULL;
   list_init(&t->locks_held);
@@ -601,16 +863,191 @@ alloc_frame(struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run(void)
 {
-  if (list_empty(&ready_list)){
-    return idle_thread;
-  }else{
-        struct thread *max_thread = list_entry(list_min(&ready_list,compare_threads_by_priority,NULL), struct thread, elem);
-        list_remove(&max_thread->elem);
-        return max_thread;
+  struct thread *next = runqueue_pop(&ready_queue);
+
+  return next != NULL ? next : idle_thread;
+}
+
+/* Returns true if T is the idle thread. */
+static bool
+is_idle_thread(struct thread *t)
+{
+  return t == idle_thread;
+}
+
+/* Returns the index of the least significant set bit of X, which
+   must be nonzero. */
+static inline int
+bit_scan_forward(uint64_t x)
+{
+  uint32_t lo = x;
+  uint32_t hi = x >> 32;
+  uint32_t idx;
+
+  ASSERT(x != 0);
+  if (lo != 0)
+  {
+    asm("bsfl %1, %0"
+        : "=r"(idx)
+        : "rm"(lo));
+    return idx;
   }
-  
-  
+  asm("bsfl %1, %0"
+      : "=r"(idx)
+      : "rm"(hi));
+  return idx + 32;
+}
+
+/* Initializes RQ to empty. */
+static void
+runqueue_init(struct runqueue *rq)
+{
+  int i;
+
+  heap_init(&rq->edf, compare_deadlines, NULL);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init(&rq->queues[i]);
+  rq->bitmap = 0;
+  rq->cnt = 0;
+}
+
+/* Appends T to the back of RQ's queue for T's priority, or adds
+   it to RQ's real-time threads.  Interrupts must be off. */
+static void
+runqueue_link(struct runqueue *rq, struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(t->status == THREAD_READY);
+  ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  rq->cnt++;
+  if (t->dl_runtime != 0)
+  {
+    heap_insert(&rq->edf, &t->edfelem);
+    return;
+  }
+  t->queued_priority = t->priority;
+  list_push_back(&rq->queues[t->priority - PRI_MIN], &t->elem);
+  rq->bitmap |= (uint64_t)1 << (PRI_MAX - t->priority);
+}
+
+/* Removes T from RQ.  Interrupts must be off. */
+static void
+runqueue_unlink(struct runqueue *rq, struct thread *t)
+{
+  struct list *queue;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(t->status == THREAD_READY);
+
+  rq->cnt--;
+  if (t->dl_runtime != 0)
+  {
+    heap_remove(&rq->edf, &t->edfelem);
+    return;
   }
+  queue = &rq->queues[t->queued_priority - PRI_MIN];
+  list_remove(&t->elem);
+  if (list_empty(queue))
+    rq->bitmap &= ~((uint64_t)1 << (PRI_MAX - t->queued_priority));
+}
+
+/* Appends T to the back of RQ's queue for its priority. */
+static void
+runqueue_push(struct runqueue *rq, struct thread *t)
+{
+  enum intr_level old_level = intr_disable();
+  t->ready_tsc = rdtsc();
+  runqueue_link(rq, t);
+  intr_set_level(old_level);
+}
+
+/* Moves T, which is in RQ, to the queue for its current
+   priority. */
+static void
+runqueue_requeue(struct runqueue *rq, struct thread *t)
+{
+  enum intr_level old_level = intr_disable();
+  runqueue_unlink(rq, t);
+  runqueue_link(rq, t);
+  intr_set_level(old_level);
+}
+
+/* Returns the real-time thread in RQ with the earliest deadline,
+   or if there is none the first thread of RQ's highest-priority
+   nonempty queue, or a null pointer if RQ is empty.  Interrupts
+   must be off. */
+static struct thread *
+runqueue_first(struct runqueue *rq)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!heap_empty(&rq->edf))
+    return heap_entry(heap_min(&rq->edf), struct thread, edfelem);
+  if (rq->bitmap != 0)
+  {
+    int priority = PRI_MAX - bit_scan_forward(rq->bitmap);
+    return list_entry(list_front(&rq->queues[priority - PRI_MIN]),
+                      struct thread, elem);
+  }
+  return NULL;
+}
+
+/* Removes and returns the thread that should run next from RQ,
+   or returns a null pointer if RQ is empty. */
+static struct thread *
+runqueue_pop(struct runqueue *rq)
+{
+  enum intr_level old_level = intr_disable();
+  struct thread *t = runqueue_first(rq);
+
+  if (t != NULL)
+    runqueue_unlink(rq, t);
+  intr_set_level(old_level);
+  return t;
+}
+
+/* Returns true if a thread in RQ should run before T. */
+static bool
+runqueue_preempts(struct runqueue *rq, struct thread *t)
+{
+  enum intr_level old_level = intr_disable();
+  struct thread *first = runqueue_first(rq);
+  bool preempts = first != NULL && thread_runs_before(first, t);
+
+  intr_set_level(old_level);
+  return preempts;
+}
+
+/* Orders real-time threads by absolute deadline. */
+static bool
+compare_deadlines(const struct heap_elem *a_, const struct heap_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct thread *a = heap_entry(a_, struct thread, edfelem);
+  const struct thread *b = heap_entry(b_, struct thread, edfelem);
+
+  return a->dl_abs_deadline < b->dl_abs_deadline;
+}
+
+/* Returns the share of the CPU, in millionths, that a real-time
+   thread with the given parameters claims. */
+static int64_t
+edf_density(int64_t runtime, int64_t period, int64_t deadline)
+{
+  return runtime * 1000000 / (deadline < period ? deadline : period);
+}
+
+/* Starts a new period for real-time thread T at time NOW, with a
+   full budget.  T must not be in a run queue. */
+static void
+edf_new_period(struct thread *t, int64_t now)
+{
+  t->dl_period_start = now;
+  t->dl_abs_deadline = now + t->dl_deadline;
+  t->dl_budget = t->dl_runtime;
+  t->dl_throttled = false;
+}
 
 /* Completes a thread switch by activating the new thread's page
    tables, and, if the previous thread is dying, destroying it.
@@ -650,7 +1087,7 @@ void thread_schedule_tail(struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
   {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    thread_page_put(prev);
   }
 }
 
@@ -664,18 +1101,121 @@ static void
 schedule(void)
 {
   struct thread *cur = running_thread();
-  struct thread *next = next_thread_to_run();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT(intr_get_level() == INTR_OFF);
   ASSERT(cur->status != THREAD_RUNNING);
+
+  /* Under the MLFQS, the thread leaving the CPU may have run part
+     of a slice since its priority was last computed, so bring it
+     up to date with its recent_cpu before it waits. */
+  if (thread_mlfqs && cur->status != THREAD_DYING)
+    priority_clac(cur, NULL);
+
+  next = next_thread_to_run();
   ASSERT(is_thread(next));
 
   if (cur != next)
+  {
+    context_switches++;
+    if (cur->status == THREAD_READY)
+      cur->acct.involuntary_switches++;
+    else
+      cur->acct.voluntary_switches++;
+    if (!is_idle_thread(next))
+    {
+      uint64_t ready = rdtsc() - next->ready_tsc;
+      next->acct.ready_cycles += ready;
+      histogram_add(&ready_latency, ready);
+    }
+    trace_event(TRACE_SWITCH, cur, next, next->priority);
     prev = switch_threads(cur, next);
+  }
   thread_schedule_tail(prev);
 }
 
+/* Returns a page for a new thread, taking one from the cache of
+   dead thread pages if possible.  The page's contents
+   are garbage: init_thread() clears the `struct thread' at its
+   base and alloc_frame() builds the initial stack frames, and
+   nothing else on the page is ever read before it is written. */
+static struct thread *
+thread_page_get(void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  if (page_cache_cnt > 0)
+    t = page_cache[--page_cache_cnt];
+  intr_set_level(old_level);
+
+  return t != NULL ? t : palloc_get_page(0);
+}
+
+/* Puts the page of dead thread T in the cache, or frees it if
+   the cache is full.  Interrupts must be off. */
+static void
+thread_page_put(struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  t->magic = 0;
+  if (page_cache_cnt < THREAD_CACHE_MAX)
+    page_cache[page_cache_cnt++] = t;
+  else
+    palloc_free_page(t);
+}
+
+/* Called by the idle thread, with interrupts off, to top up the
+   page cache to THREAD_CACHE_LOW pages.  The page allocator never
+   sleeps, so the idle thread can use it.  PAL_NOCACHE keeps it
+   from draining the cache to fill the cache, which would loop
+   forever once the kernel pool runs out. */
+static void
+thread_cache_refill(void)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  while (page_cache_cnt < THREAD_CACHE_LOW)
+  {
+    void *page = palloc_get_page(PAL_NOCACHE);
+    if (page == NULL)
+      break;
+    page_cache[page_cache_cnt++] = page;
+  }
+}
+
+/* Frees the pages in the cache of dead thread pages.  Called by
+   the page allocator when it runs out of pages.  Returns true if
+   any pages were freed, false if the cache was empty. */
+bool thread_cache_drain(void)
+{
+  enum intr_level old_level;
+  bool drained = false;
+
+  old_level = intr_disable();
+  while (page_cache_cnt > 0)
+  {
+    palloc_free_page(page_cache[--page_cache_cnt]);
+    drained = true;
+  }
+  intr_set_level(old_level);
+  return drained;
+}
+
+/* Adds the counts in B to A. */
+static void
+add_acct(struct thread_acct *a, const struct thread_acct *b)
+{
+  a->run_ticks += b->run_ticks;
+  a->voluntary_switches += b->voluntary_switches;
+  a->involuntary_switches += b->involuntary_switches;
+  a->ready_cycles += b->ready_cycles;
+  a->lock_wait_cycles += b->lock_wait_cycles;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid(void)
@@ -694,33 +1234,47 @@ allocate_tid(void)
 uint32_t thread_stack_ofs = offsetof(struct thread, stack);
 
 
-//increament recent_cpu for current thread by 1
+//increament recent_cpu for current thread by 1, counted in ticks
+//at the default timer frequency so the priority formula keeps its
+//meaning whatever "-hz" is set to
 void recent_inc(){
   struct thread *t = thread_current();
-  t->recent_cpu = add_int(t->recent_cpu, 1);
+  if (timer_freq == TIMER_FREQ_DEFAULT)
+    t->recent_cpu = add_int(t->recent_cpu, 1);
+  else
+    t->recent_cpu = add_real(t->recent_cpu,
+                             div_int(real_from_int(TIMER_FREQ_DEFAULT), timer_freq));
 }
 void recent_clac(struct thread *t,void *aux UNUSED){
   ASSERT(is_thread(t));
-  if(t==idle_thread)
+  if(is_idle_thread(t))
     return;
   t->recent_cpu = add_int(mul_real(div_real(mul_int(load_avg,2), add_int(mul_int(load_avg,2), 1)), t->recent_cpu), t->nice);
   priority_clac(t,NULL);
 }
 void load_avg_calc(){
-  int ready_threads = list_size(&ready_list);
-  if(thread_current() != idle_thread)
+  int ready_threads = ready_queue.cnt;
+  if(!is_idle_thread(thread_current()))
     ready_threads++;
   load_avg = add_real(mul_real(div_int(real_from_int(59), 60), load_avg), mul_real(div_int(real_from_int(1), 60), real_from_int(ready_threads)));
 }
 void priority_clac(struct thread *t,void *aux UNUSED){
   ASSERT(is_thread(t));
-  if(t==idle_thread)
+  if(is_idle_thread(t))
     return;
+  int old_priority = t->priority;
   int priority=int_floor(sub_int(sub_real(real_from_int(PRI_MAX), div_int(t->recent_cpu, 4)),2*t->nice));
   t->priority = priority;
   if(t->priority > PRI_MAX)
     t->priority = PRI_MAX;
   if(t->priority < PRI_MIN)
     t->priority = PRI_MIN;
+  if(t->status == THREAD_READY)
+    update_ready_threads(t);
+  if(t->priority != old_priority){
+    enum intr_level old_level = intr_disable();
+    update_waiting_thread(t);
+    intr_set_level(old_level);
+  }
 }
 
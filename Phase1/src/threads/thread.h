@@ -2,9 +2,12 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/fixed_point.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -33,6 +36,18 @@ typedef int tid_t;
 #define NICE_MAX 20
 #define NICE_DEFAULT 0
 #define NICE_MIN -20
+
+/* CPU accounting for a thread, kept by thread.c.  Cycle counts
+   are in time-stamp counter cycles. */
+struct thread_acct
+{
+   int64_t run_ticks;                 /* Timer ticks spent running. */
+   long long voluntary_switches;      /* Switches out by blocking or exiting. */
+   long long involuntary_switches;    /* Switches out while still ready. */
+   uint64_t ready_cycles;             /* Time spent ready but not running. */
+   uint64_t lock_wait_cycles;         /* Time spent waiting for locks. */
+};
+
 /* A kernel thread or user process.
    Each thread structure is stored in its own 4 kB page.  The
    thread structure itself sits at the very bottom of the page
@@ -77,12 +92,11 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c)
+   while the thread is ready.  A thread blocked on a semaphore or
+   condition variable is instead in that object's waiters heap
+   (synch.c), through `waitelem' or an element of its own on the
+   waiting thread's stack. */
 struct thread
 {
    /* Owned by thread.c. */
@@ -90,8 +104,9 @@ struct thread
    enum thread_status status;         /* Thread state. */
    char name[16];                     /* Name (for debugging purposes). */
    uint8_t *stack;                    /* Saved stack pointer. */
-   int64_t remaining_time_to_wake_up; /* Ticks remaining from waking up. */
+   int64_t wake_tick;                 /* Timer tick at which to wake up. */
    int priority;                      /* Priority. */
+   int queued_priority;               /* Run queue holding the thread while ready. */
    int real_priority;                 // stores the real (original) priority of the thread
    struct list locks_held;            // the list occupies the locks held by the thread
    struct lock *locked_by;            // it points to the lock which the thread is currently waiting for
@@ -99,14 +114,38 @@ struct thread
    int nice;                          //thread nice value
    real recent_cpu;                   // CPU ticks while thread is holding the CPU
 
-   struct list_elem sleepingelem; 
+   struct heap_elem sleepingelem;     /* Heap element for sleeping threads. */
+   struct thread_acct acct;           /* CPU accounting. */
+   uint64_t ready_tsc;                /* When it last became ready. */
+
+   /* Earliest-deadline-first real-time class, in timer ticks.
+      The thread is in the class iff DL_RUNTIME is nonzero. */
+   int64_t dl_runtime;                /* CPU time allowed per period. */
+   int64_t dl_period;                 /* Period. */
+   int64_t dl_deadline;               /* Deadline within each period. */
+   int64_t dl_period_start;           /* Start of the current period. */
+   int64_t dl_abs_deadline;           /* Current absolute deadline. */
+   int64_t dl_budget;                 /* CPU time left this period. */
+   bool dl_throttled;                 /* Out of budget until next period? */
+   int dl_misses;                     /* Jobs finished after their deadline. */
+   struct heap_elem edfelem;          /* Element in run queue's EDF heap. */
    struct list_elem allelem;          /* List element for all threads list. */
-                                      /*------------------------------------------------------------------------------*/
-       /* List element for sleeping threads. */
 
    /*--------------------------------------------------------------------------------*/
-   /* Shared between thread.c and synch.c. */
-   struct list_elem elem; /* List element. */
+   /* Owned by thread.c. */
+   struct list_elem elem; /* Run queue element. */
+
+   /* Owned by synch.c. */
+   struct semaphore *waiting_sema;    /* Semaphore being waited on, if any. */
+   struct heap_elem waitelem;         /* Heap element in its waiters. */
+   int64_t wait_seq;                  /* Arrival order among its waiters. */
+   struct condition *waiting_cond;    /* Condition being waited on, if any. */
+   struct heap_elem *cond_waiter;     /* Our element in its waiters. */
+   struct rwlock_hold rw_holds[RWLOCK_READ_MAX]; /* rwlocks held for reading. */
+   struct rwlock *waiting_rwlock;     /* rwlock whose readers it waits out. */
+
+   /* Owned by malloc.c. */
+   struct malloc_magazine mags[MALLOC_MAG_CLASSES]; /* Free blocks. */
 
 #ifdef USERPROG
    /* Owned by userprog/process.c. */
@@ -122,11 +161,18 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Number of timer ticks each thread may run before yielding to
+   another of equal priority.  Controlled by kernel command-line
+   option "-slice". */
+#define TIME_SLICE_DEFAULT 4
+extern int thread_time_slice;
+
 void thread_init(void);
 void thread_start(void);
 
 void thread_tick(void);
 void thread_print_stats(void);
+bool thread_cache_drain(void);
 
 typedef void thread_func(void *aux);
 tid_t thread_create(const char *name, int priority, thread_func *, void *);
@@ -148,6 +194,11 @@ void thread_foreach(thread_action_func *, void *);
 int thread_get_priority(void);
 void thread_set_priority(int);
 
+bool thread_set_deadline(int64_t runtime, int64_t period, int64_t deadline);
+void thread_deadline_yield(void);
+int thread_get_deadline_misses(void);
+bool thread_runs_before(const struct thread *, const struct thread *);
+
 int thread_get_nice(void);
 void thread_set_nice(int);
 int thread_get_recent_cpu(void);
@@ -155,8 +206,10 @@ int thread_get_load_avg(void);
 
 void thread_foreach(thread_action_func *, void *);
 void sleep_thread(int64_t);
+int64_t thread_next_wake_tick(void);
+void thread_account_lock_wait(uint64_t cycles);
 bool compare_threads_by_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
-bool compare_threads_by_priority_sleeping(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
+bool compare_threads_by_wake_tick(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED);
 void update_thread_priority(struct thread *);
 void update_ready_threads(struct thread *);
 void try_thread_yield(void);
@@ -0,0 +1,88 @@
+#include "threads/trace.h"
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of events kept.  Must be a power of 2. */
+#define TRACE_CNT 2048
+
+/* A recorded event. */
+struct trace_record
+  {
+    uint64_t tsc;               /* Time-stamp counter. */
+    int64_t tick;               /* Timer tick. */
+    tid_t tid;                  /* Thread the event is about. */
+    tid_t other;                /* Other thread involved, or 0. */
+    int16_t arg;                /* Event-specific argument. */
+    uint8_t type;               /* An enum trace_type. */
+  };
+
+/* Ring buffer of the most recent events.  The next event goes in
+   records[next % TRACE_CNT]. */
+static struct trace_record records[TRACE_CNT];
+static uint64_t next;
+
+bool trace_enabled;
+
+static void dump_thread (struct thread *, void *aux);
+
+/* Records an event of the given TYPE about thread T.  OTHER and
+   ARG depend on TYPE; see trace.h.  May be called from any
+   context, including interrupt handlers. */
+void
+trace_event (enum trace_type type, struct thread *t, struct thread *other,
+             int arg)
+{
+  struct trace_record *r;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  r = &records[next++ % TRACE_CNT];
+  r->tsc = rdtsc ();
+  r->tick = timer_ticks ();
+  r->tid = t->tid;
+  r->other = other != NULL ? other->tid : 0;
+  r->arg = arg;
+  r->type = type;
+  intr_set_level (old_level);
+}
+
+/* Prints the recorded events, oldest first, followed by the
+   names of the threads that still exist.  Every line begins with
+   "trace:", so that the trace can be picked out of the rest of
+   the kernel's output. */
+void
+trace_dump (void)
+{
+  static const char *names[] =
+    {"switch", "block", "unblock", "wakeup", "donate"};
+  enum intr_level old_level;
+  uint64_t first, i;
+
+  /* Stop recording while we print, or printing would overwrite
+     the oldest events. */
+  old_level = intr_disable ();
+  first = next > TRACE_CNT ? next - TRACE_CNT : 0;
+  printf ("trace: begin %"PRIu64" events, %"PRIu64" lost, %d Hz\n",
+          next - first, first, TIMER_FREQ);
+  for (i = first; i < next; i++)
+    {
+      const struct trace_record *r = &records[i % TRACE_CNT];
+      printf ("trace: %"PRIu64" %"PRId64" %s %d %d %d\n",
+              r->tsc, r->tick, names[r->type], r->tid, r->other, r->arg);
+    }
+  thread_foreach (dump_thread, NULL);
+  printf ("trace: end\n");
+  intr_set_level (old_level);
+}
+
+/* Prints the name of thread T for trace_dump(). */
+static void
+dump_thread (struct thread *t, void *aux UNUSED)
+{
+  printf ("trace: thread %d %s\n", t->tid, t->name);
+}
@@ -0,0 +1,35 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+
+/* Scheduler event trace.
+
+   Scheduling events are always recorded, with their timer tick
+   and time-stamp counter, in a fixed-size ring buffer that keeps
+   the most recent TRACE_CNT events.  Recording an event costs a
+   few stores with interrupts off.  trace_dump() prints the buffer
+   to the console, one event per line; utils/pintos-trace turns
+   that output into a timeline. */
+
+struct thread;
+
+/* Kinds of events. */
+enum trace_type
+  {
+    TRACE_SWITCH,               /* THREAD switches to OTHER. */
+    TRACE_BLOCK,                /* THREAD blocks. */
+    TRACE_UNBLOCK,              /* OTHER makes THREAD ready. */
+    TRACE_WAKEUP,               /* Sleeping THREAD is due. */
+    TRACE_DONATE                /* OTHER donates ARG to THREAD. */
+  };
+
+/* Set by the "-o trace" kernel option to dump the trace at
+   shutdown. */
+extern bool trace_enabled;
+
+void trace_event (enum trace_type, struct thread *, struct thread *other,
+                  int arg);
+void trace_dump (void);
+
+#endif /* threads/trace.h */
@@ -3,8 +3,12 @@
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "devices/timer.h"
 
 static void syscall_handler (struct intr_frame *);
+static bool is_user_range (const void *uaddr, size_t size);
 
 void
 syscall_init (void) 
@@ -13,8 +17,33 @@ syscall_init (void)
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
+  const uint32_t *args = f->esp;
+
+  /* nsleep (NS): NS is passed as two 32-bit halves, low first. */
+  if (is_user_range (args, 3 * sizeof *args) && args[0] == SYS_NSLEEP)
+    {
+      timer_nsleep (((int64_t) args[2] << 32) | args[1]);
+      return;
+    }
+
   printf ("system call!\n");
   thread_exit ();
 }
+
+/* Returns true if the SIZE bytes starting at user address UADDR
+   are all mapped in the running process, false otherwise. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  const uint8_t *p = uaddr;
+  const uint8_t *end = p + size;
+
+  if (size == 0 || end < p || !is_user_vaddr (end - 1))
+    return false;
+  for (p = pg_round_down (p); p < end; p += PGSIZE)
+    if (pagedir_get_page (thread_current ()->pagedir, p) == NULL)
+      return false;
+  return true;
+}